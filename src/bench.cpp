@@ -0,0 +1,579 @@
+// bench.cpp - timings of iterables against hand written loops
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include "fms_arena.h"
+#include "fms_bootstrap.h"
+#include "fms_cache.h"
+#include "fms_generator.h"
+#include "fms_iterable.h"
+#include "fms_live.h"
+#include "fms_portfolio.h"
+#include "fms_pwflat.h"
+#include "fms_reduce.h"
+#include "fms_schedule.h"
+#include "fms_simd.h"
+#include "fms_snapshot.h"
+
+using namespace fms::iterable;
+
+// nanoseconds per item of f() over n items, best of reps
+template<class F>
+inline double ns_per_item(const F& f, size_t n, size_t reps = 10)
+{
+	using clock = std::chrono::steady_clock;
+	double best = std::numeric_limits<double>::max();
+
+	for (size_t r = 0; r < reps; ++r) {
+		auto b = clock::now();
+		f();
+		auto e = clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(e - b).count());
+	}
+
+	return best / n;
+}
+
+volatile long long sink;
+
+void bench_pipe(size_t n = 10'000'000)
+{
+	auto no3 = [](auto i) { return *i % 3 != 0; };
+	auto sq = [](long long x) { return x * x; };
+	auto mix = [](long long y) { return y ^ (y >> 3); };
+
+	double pipe = ns_per_item([&]() {
+		long long sum = 0;
+		for (auto s = sequence<long long>() | pipe::when(no3) | pipe::apply(sq) | pipe::apply(mix) | pipe::take(n); s; ++s) {
+			sum += *s;
+		}
+		sink = sum;
+	}, n);
+
+	double loop = ns_per_item([&]() {
+		long long sum = 0;
+		size_t k = 0;
+		for (long long i = 0; k < n; ++i) {
+			if (i % 3 != 0) {
+				long long y = i * i;
+				sum += y ^ (y >> 3);
+				++k;
+			}
+		}
+		sink = sum;
+	}, n);
+
+	printf("pipe    %6.3f ns/item  loop %6.3f ns/item  ratio %.2f\n", pipe, loop, pipe / loop);
+}
+
+volatile double dsink;
+
+void bench_reduce(size_t n = 10'000'000)
+{
+	std::vector<double> u(n), c(n);
+	for (size_t k = 0; k < n; ++k) {
+		u[k] = k * 30. / n;
+		c[k] = 1 + (k % 7);
+	}
+	auto pv = [](const std::pair<double, double>& uc) { return uc.second * exp(-0.03 * uc.first); };
+	auto uc = pair(container(u), container(c));
+
+	double seq = ns_per_item([&]() {
+		dsink = accumulate(std::plus<double>{}, apply(pv, uc), 0.);
+	}, n);
+	double one = ns_per_item([&]() {
+		dsink = transform_reduce(std::plus<double>{}, pv, uc, 0., nullptr);
+	}, n);
+	double all = ns_per_item([&]() {
+		dsink = transform_reduce(std::plus<double>{}, pv, uc, 0.);
+	}, n);
+
+	printf("reduce  accumulate %6.3f ns/item  1 thread %6.3f ns/item  %zu threads %6.3f ns/item\n",
+		seq, one, fms::parallel::pool::instance().size(), all);
+}
+
+// payment times dt, 2 dt, ..., n dt
+class schedule {
+	double dt;
+	int k, n;
+public:
+	using iterator_category = std::input_iterator_tag;
+	using difference_type = ptrdiff_t;
+	using value_type = double;
+	using pointer = double*;
+	using reference = double&;
+
+	schedule(double dt, int n)
+		: dt(dt), k(1), n(n)
+	{ }
+	bool operator==(const schedule&) const = default;
+	schedule begin() const
+	{
+		return *this;
+	}
+	schedule end() const
+	{
+		schedule s{ *this };
+		s.k = n + 1;
+
+		return s;
+	}
+	explicit operator bool() const
+	{
+		return k <= n;
+	}
+	value_type operator*() const
+	{
+		return k * dt;
+	}
+	schedule& operator++()
+	{
+		++k;
+
+		return *this;
+	}
+	schedule operator++(int)
+	{
+		schedule s{ *this };
+		operator++();
+
+		return s;
+	}
+};
+
+generator<double> schedule_gen(fms::arena&, double dt, int n)
+{
+	for (int k = 1; k <= n; ++k) {
+		co_yield k * dt;
+	}
+}
+generator<double> schedule_gen(double dt, int n)
+{
+	for (int k = 1; k <= n; ++k) {
+		co_yield k * dt;
+	}
+}
+
+void bench_generator(size_t m = 500'000, int n = 20)
+{
+	auto df = [](double u) { return exp(-0.03 * u); };
+	fms::arena a(4096);
+
+	double cls = ns_per_item([&]() {
+		double s = 0;
+		for (size_t j = 0; j < m; ++j) {
+			s += accumulate(std::plus<double>{}, apply(df, schedule(0.5, n)), 0.);
+		}
+		dsink = s;
+	}, m * n);
+	double gen = ns_per_item([&]() {
+		double s = 0;
+		for (size_t j = 0; j < m; ++j) {
+			s += accumulate(std::plus<double>{}, apply(df, schedule_gen(a, 0.5, n)), 0.);
+			a.reset();
+		}
+		dsink = s;
+	}, m * n);
+	double heap = ns_per_item([&]() {
+		double s = 0;
+		for (size_t j = 0; j < m; ++j) {
+			s += accumulate(std::plus<double>{}, apply(df, schedule_gen(0.5, n)), 0.);
+		}
+		dsink = s;
+	}, m * n);
+
+	printf("generator  class %6.3f ns/item  arena %6.3f ns/item  new %6.3f ns/item\n", cls, gen, heap);
+}
+
+void bench_simd(size_t n = 1'000'000)
+{
+	using fms::simd::level;
+	std::vector<double> v(n);
+	for (size_t k = 0; k < n; ++k) {
+		v[k] = static_cast<double>(k);
+	}
+	v.back() = -1; // no early exit
+	auto find = [&](level l) {
+		return ns_per_item([&]() { sink = fms::simd::find<fms::simd::cmp::lt>(v.data(), n, 0., l); }, n, 100);
+	};
+	auto mismatch = [&](level l) {
+		return ns_per_item([&]() { sink = fms::simd::mismatch(v.data(), v.data(), n, l); }, n, 100);
+	};
+
+	double loop = ns_per_item([&]() { sink = length(upto(take(n, ptr(v.data())), [](auto i) { return *i < 0; })); }, n, 100);
+	printf("find    scalar %6.3f  sse2 %6.3f  avx2 %6.3f  upto %6.3f  ns/item\n",
+		find(level::scalar), find(level::sse2), fms::simd::best() == level::avx2 ? find(level::avx2) : NAN, loop);
+	printf("equal   scalar %6.3f  sse2 %6.3f  avx2 %6.3f  ns/item\n",
+		mismatch(level::scalar), mismatch(level::sse2), fms::simd::best() == level::avx2 ? mismatch(level::avx2) : NAN);
+
+	std::vector<double> x(n / 10), y(n / 10);
+	for (size_t k = 0; k < x.size(); ++k) {
+		x[k] = -0.0001 * k;
+	}
+	auto exp = [&](level l) {
+		return ns_per_item([&]() { fms::simd::exp(x.data(), y.data(), x.size(), l); sink = (long long)y.back(); }, x.size(), 100);
+	};
+	printf("exp     scalar %6.3f  sse2 %6.3f  avx2 %6.3f  ns/item\n",
+		exp(level::scalar), exp(level::sse2), fms::simd::best() == level::avx2 ? exp(level::avx2) : NAN);
+}
+
+void bench_indexed(size_t n = 50, size_t m = 100'000)
+{
+	std::vector<double> t(n), x(n), u(m);
+	for (size_t i = 0; i < n; ++i) {
+		t[i] = 0.5 * (i + 1);
+		x[i] = 0.01 + 0.001 * i;
+	}
+	for (size_t k = 0; k < m; ++k) {
+		u[k] = t.back() * k / m;
+	}
+	fms::pwflat::indexed<> f{ container(t), container(x) };
+	volatile double s;
+
+	double scan = ns_per_item([&]() {
+		double d = 0;
+		for (double _u : u) {
+			d += exp(-fms::pwflat::integral(container(t), container(x), _u));
+		}
+		s = d;
+	}, m);
+	double search = ns_per_item([&]() {
+		double d = 0;
+		for (double _u : u) {
+			d += f.discount(_u);
+		}
+		s = d;
+	}, m);
+	double hinted = ns_per_item([&]() {
+		double d = 0;
+		fms::pwflat::indexed_view<>::hint h;
+		for (double _u : u) {
+			d += f.discount(_u, h);
+		}
+		s = d;
+	}, m);
+
+	std::vector<double> D(m);
+	double batch = ns_per_item([&]() {
+		f.discount(u, D);
+		s = D.back();
+	}, m);
+
+	printf("discount  scan %6.3f  search %6.3f  hint %6.3f  batch %6.3f  ns/item\n", scan, search, hinted, batch);
+
+	// 3 month forwards
+	std::vector<double> p(m, 0.25), dcf(m, 0.25), F(m);
+	double fras = ns_per_item([&]() {
+		double F_ = 0;
+		for (size_t k = 0; k < m; ++k) {
+			F_ += f.forward(u[k], p[k], dcf[k]);
+		}
+		s = F_;
+	}, m);
+	double fras_batch = ns_per_item([&]() {
+		f.forward(u, p, dcf, F);
+		s = F.back();
+	}, m);
+	printf("forward  each %6.3f  batch %6.3f  ns/item\n", fras, fras_batch);
+}
+
+void bench_static(size_t m = 100'000)
+{
+	constexpr size_t N = 12;
+	std::array<double, N> t, x;
+	for (size_t i = 0; i < N; ++i) {
+		t[i] = 0.5 * (i + 1);
+		x[i] = 0.01 + 0.001 * i;
+	}
+	fms::pwflat::static_curve<N> f(t, x, x.back());
+	fms::pwflat::indexed<> g{ array(t.size(), t.data()), array(x.size(), x.data()), x.back() };
+	std::vector<double> u(m);
+	for (size_t k = 0; k < m; ++k) {
+		u[k] = 7 * double(k * 7919 % m) / m; // unsorted
+	}
+
+	volatile double s;
+	double fixed = ns_per_item([&]() {
+		double I = 0;
+		for (double _u : u) {
+			I += f.integral(_u);
+		}
+		s = I;
+	}, m);
+	double search = ns_per_item([&]() {
+		double I = 0;
+		for (double _u : u) {
+			I += g.integral(_u);
+		}
+		s = I;
+	}, m);
+
+	printf("integral %zu pillars  static %6.3f  indexed %6.3f  ns/item\n", N, fixed, search);
+}
+
+void bench_portfolio(size_t m = 20'000, size_t n = 40)
+{
+	std::vector<double> t(n), x(n);
+	for (size_t i = 0; i < n; ++i) {
+		t[i] = 0.25 * (i + 1);
+		x[i] = 0.01 + 0.001 * i;
+	}
+	fms::pwflat::indexed<> f{ container(t), container(x) };
+
+	// quarterly bonds with staggered maturities
+	std::vector<std::vector<double>> u(m), c(m);
+	fms::pwflat::portfolio<> p;
+	for (size_t j = 0; j < m; ++j) {
+		for (size_t i = 0; i <= j % n; ++i) {
+			u[j].push_back(t[i]);
+			c[j].push_back(i == j % n ? 1.01 : 0.01);
+		}
+		p.add(container(u[j]), container(c[j]));
+	}
+	p.compile();
+	size_t flows = 0;
+	for (const auto& uj : u) {
+		flows += uj.size();
+	}
+
+	volatile double s;
+	double each = ns_per_item([&]() {
+		double pv = 0;
+		for (size_t j = 0; j < m; ++j) {
+			pv += fms::pwflat::present_value(container(t), container(x), container(u[j]), container(c[j])).first;
+		}
+		s = pv;
+	}, flows);
+	std::vector<double> pv(m), D(p.times().size());
+	double sweep = ns_per_item([&]() {
+		p.present_value(f, pv, D);
+		s = pv.back();
+	}, flows);
+	fms::parallel::pool pool;
+	double threads = ns_per_item([&]() {
+		p.present_value(f, pv, D, &pool);
+		s = pv.back();
+	}, flows);
+
+	std::vector<double> g(n + 1);
+	double adjoint = ns_per_item([&]() {
+		fms::pwflat::adjoint<> a(f);
+		s = p.present_value(a);
+		a.gradient(g);
+	}, flows);
+
+	printf("pv  each %6.3f  sweep %6.3f  %zu threads %6.3f  adjoint %6.3f  ns/cash flow\n", each, sweep, pool.size(), threads, adjoint);
+
+	// tick on a late pillar
+	fms::pwflat::live<> l(f);
+	p.present_value(l.view(), pv, D);
+	double full = ns_per_item([&]() {
+		l.update_pillar(n - 5, 0.05);
+		p.present_value(l.view(), pv, D);
+	}, 1);
+	double incremental = ns_per_item([&]() {
+		auto c = l.update_pillar(n - 5, 0.05);
+		p.update(l.view(), c.t0, pv, D);
+	}, 1);
+	printf("tick  full %8.0f  incremental %8.0f  ns\n", full, incremental);
+
+	// month end payment dates repeat across the book
+	fms::pwflat::discount_cache<> cache(l);
+	double cached = ns_per_item([&]() {
+		double pv_ = 0;
+		for (size_t j = 0; j < m; ++j) {
+			for (size_t i = 0; i < u[j].size(); ++i) {
+				pv_ += c[j][i] * cache.discount(u[j][i]);
+			}
+		}
+		s = pv_;
+	}, flows);
+	double direct = ns_per_item([&]() {
+		double pv_ = 0;
+		for (size_t j = 0; j < m; ++j) {
+			for (size_t i = 0; i < u[j].size(); ++i) {
+				pv_ += c[j][i] * l.view().discount(u[j][i]);
+			}
+		}
+		s = pv_;
+	}, flows);
+	printf("cache  %zu pillars  direct %6.3f  cached %6.3f  ns/cash flow  hits %zu  misses %zu\n", n, direct, cached, cache.hits(), cache.misses());
+
+	// daily pillars: the binary search for each discount misses the CPU cache
+	size_t nd = 365 * 30;
+	std::vector<double> td(nd), xd(nd);
+	for (size_t i = 0; i < nd; ++i) {
+		td[i] = (i + 1) / 365.;
+		xd[i] = 0.01 + 0.00001 * (i % 997);
+	}
+	fms::pwflat::live<> ld(fms::pwflat::indexed<>{ container(td), container(xd) });
+	fms::pwflat::discount_cache<> daily(ld);
+	cached = ns_per_item([&]() {
+		double pv_ = 0;
+		for (size_t j = 0; j < m; ++j) {
+			for (size_t i = 0; i < u[j].size(); ++i) {
+				pv_ += c[j][i] * daily.discount(u[j][i]);
+			}
+		}
+		s = pv_;
+	}, flows);
+	direct = ns_per_item([&]() {
+		double pv_ = 0;
+		for (size_t j = 0; j < m; ++j) {
+			for (size_t i = 0; i < u[j].size(); ++i) {
+				pv_ += c[j][i] * ld.view().discount(u[j][i]);
+			}
+		}
+		s = pv_;
+	}, flows);
+	printf("cache  %zu pillars  direct %6.3f  cached %6.3f  ns/cash flow\n", nd, direct, cached);
+}
+
+void bench_snapshot(size_t m = 50'000, size_t n = 20)
+{
+	using clock = std::chrono::steady_clock;
+	auto path = (std::filesystem::temp_directory_path() / "fms_bench_snapshot.bin").string();
+	{
+		fms::pwflat::snapshot_writer w(path.c_str());
+		for (size_t j = 0; j < m; ++j) {
+			fms::pwflat::indexed<> f;
+			for (size_t i = 0; i < n; ++i) {
+				f.push_back(0.5 * (i + 1), 0.01 + 1e-7 * j + 1e-4 * i);
+			}
+			w.add(f);
+		}
+	}
+
+	auto b = clock::now();
+	fms::pwflat::snapshot s(path.c_str());
+	double D = 0;
+	for (size_t j = 0; j < s.size(); ++j) {
+		D += s[j].discount(5.);
+	}
+	auto e = clock::now();
+	volatile double d = D;
+	(void)d;
+
+	printf("snapshot  %zu curves  open and discount %6.2f ms\n", s.size(), std::chrono::duration<double, std::milli>(e - b).count());
+	std::filesystem::remove(path);
+}
+
+// annual swaps to n years on scenarios of m slowly moving quotes
+void bench_bootstrap(size_t m = 2'000, size_t n = 30)
+{
+	using I = fms::bootstrap::instrument<>;
+	std::vector<I> is;
+	std::vector<double> u, dcf;
+	for (size_t i = 1; i <= n; ++i) {
+		u.push_back(double(i));
+		dcf.push_back(1);
+		is.push_back(I::swap(0, u, dcf));
+	}
+	std::vector<double> q;
+	for (size_t j = 0; j < m; ++j) {
+		for (size_t i = 0; i < n; ++i) {
+			q.push_back(0.02 + 0.0005 * i + 1e-6 * j);
+		}
+	}
+
+	volatile double s;
+	std::vector<double> x(q.size());
+	double cold = ns_per_item([&]() {
+		fms::bootstrap::sequential<> b;
+		for (size_t j = 0; j < m; ++j) {
+			s = b.solve(is, std::span<const double>(q).subspan(j * n, n)).rate()[n - 1];
+		}
+	}, m, 3);
+	double warm = ns_per_item([&]() {
+		fms::bootstrap::batch<double, double>(is, q, x);
+		s = x.back();
+	}, m, 3);
+	fms::parallel::pool pool;
+	double threads = ns_per_item([&]() {
+		fms::bootstrap::batch<double, double>(is, q, x, &pool);
+		s = x.back();
+	}, m, 3);
+
+	printf("bootstrap  %zu swaps  cold %8.0f  warm %8.0f  %zu threads %8.0f  ns/curve\n", n, cold, warm, pool.size(), threads);
+
+	fms::bootstrap::global<> g;
+	size_t steps = 0;
+	double newton = ns_per_item([&]() {
+		for (size_t j = 0; j < 10; ++j) {
+			s = g.solve(std::span<const double>(u), is, std::span<const double>(q).subspan(j * n, n)).rate()[n - 1];
+			steps += g.iterations();
+		}
+	}, 10, 3);
+	printf("bootstrap  %zu swaps  global %8.0f  ns/curve  %4.1f Newton steps\n", n, newton, steps / 30.);
+
+	// par point bumps from the base
+	g.solve(std::span<const double>(u), is, std::span<const double>(q).first(n));
+	std::vector<double> qb(q.begin(), q.begin() + n);
+	steps = 0;
+	double chord = ns_per_item([&]() {
+		for (size_t j = 0; j < n; ++j) {
+			qb[j] += 1e-4;
+			s = g.rebootstrap(qb).rate()[n - 1];
+			steps += g.iterations();
+			qb[j] -= 1e-4;
+		}
+	}, n, 3);
+	fms::bootstrap::global<> h;
+	std::vector<double> x0(g.curve().rate().data(), g.curve().rate().data() + n);
+	double newton0 = ns_per_item([&]() {
+		for (size_t j = 0; j < n; ++j) {
+			qb[j] += 1e-4;
+			s = h.solve(std::span<const double>(u), is, qb, x0).rate()[n - 1];
+			qb[j] -= 1e-4;
+		}
+	}, n, 3);
+	printf("bootstrap  %zu swaps  rebootstrap %8.0f  warm global %8.0f  ns/curve  %4.1f Broyden steps  %zu fallbacks\n",
+		n, chord, newton0, steps / (3. * n), g.fallbacks());
+}
+
+// swaps on standard tenors from a few start dates
+void bench_schedule(size_t m = 10'000)
+{
+	using namespace fms::schedule;
+	using std::chrono::year;
+	year_month_day v = year{ 2024 } / 1 / 2;
+	auto key_of = [v](size_t j) {
+		auto e = year_month_day(sys_days(v) + std::chrono::days(2 + j % 5));
+		return key{ e, e + std::chrono::years(1 + j % 30), months{ 6 }, roll::backward, day_count::thirty_360 };
+	};
+
+	volatile double s;
+	double generated = ns_per_item([&]() {
+		for (size_t j = 0; j < m; ++j) {
+			s = generate(key_of(j), v).dcf.back();
+		}
+	}, m, 3);
+	table<> t(v);
+	double interned = ns_per_item([&]() {
+		for (size_t j = 0; j < m; ++j) {
+			s = t(key_of(j))->dcf.back();
+		}
+	}, m, 3);
+
+	printf("schedule  generated %6.0f  interned %6.0f  ns/swap  %zu schedules\n", generated, interned, t.size());
+}
+
+int main()
+{
+	bench_pipe();
+	bench_reduce();
+	bench_generator();
+	bench_simd();
+	bench_indexed();
+	bench_static();
+	bench_portfolio();
+	bench_snapshot();
+	bench_bootstrap();
+	bench_schedule();
+
+	return 0;
+}
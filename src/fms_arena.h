@@ -0,0 +1,96 @@
+// fms_arena.h - monotonic memory arena
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace fms {
+
+	// Hand out memory from a fixed block and release it all at once.
+	// Not thread safe.
+	class arena {
+		std::unique_ptr<std::byte[]> own;
+		std::byte* b;
+		size_t n, off;
+	public:
+		// arena owning n bytes
+		arena(size_t n)
+			: own(new std::byte[n]), b(own.get()), n(n), off(0)
+		{ }
+		// user responsible for buffer lifetime
+		arena(void* p, size_t n)
+			: b(static_cast<std::byte*>(p)), n(n), off(0)
+		{ }
+		arena(const arena&) = delete;
+		arena& operator=(const arena&) = delete;
+		~arena()
+		{ }
+
+		// bytes in use
+		size_t used() const
+		{
+			return off;
+		}
+		size_t capacity() const
+		{
+			return n;
+		}
+
+		// align is a power of 2, throw std::bad_alloc when exhausted
+		void* allocate(size_t m, size_t align = alignof(std::max_align_t))
+		{
+			uintptr_t p = reinterpret_cast<uintptr_t>(b + off);
+			size_t pad = (0 - p) & (align - 1);
+
+			if (pad + m > n - off) {
+				throw std::bad_alloc{};
+			}
+			off += pad + m;
+
+			return b + off - m;
+		}
+		// memory is only reclaimed by reset
+		void deallocate(void*, size_t)
+		{ }
+		void reset()
+		{
+			off = 0;
+		}
+
+#ifdef _DEBUG
+		static int test()
+		{
+			{
+				arena a(64);
+				assert(0 == a.used());
+				void* p = a.allocate(8);
+				void* q = a.allocate(8, 32);
+				assert(p != q);
+				assert(0 == reinterpret_cast<uintptr_t>(q) % 32);
+				assert(a.used() >= 16);
+				a.reset();
+				assert(0 == a.used());
+				assert(p == a.allocate(8));
+			}
+			{
+				alignas(16) std::byte buf[32];
+				arena a(buf, sizeof(buf));
+				assert(buf == a.allocate(32, 16));
+				try {
+					a.allocate(1);
+					assert(false);
+				}
+				catch (const std::bad_alloc&) {
+				}
+			}
+
+			return 0;
+		}
+#endif // _DEBUG
+	};
+
+} // namespace fms
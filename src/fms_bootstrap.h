@@ -1,56 +1,814 @@
 // fms_bootstrap.cpp - bootstrap a curve
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <algorithm>
 #include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
 #include "fms_iterable.h"
+#include "fms_lu.h"
+#include "fms_parallel.h"
+#include "fms_portfolio.h"
 #include "fms_pwflat.h"
+#include "fms_root1d.h"
 
 using namespace fms::iterable;
 
 namespace fms::bootstrap {
 
-	inline const char* next_doc = R"(
-Given a piecewise flat curve t, x find next point that reprices u, c.
-\(p = pv_0 + D_0 \sum c * exp(-f(u - u0))\).
-)";
-	template<input_iterable T, input_iterable X,
-		class _T = typename T::value_type, class _X = typename X::value_type>
-	inline std::pair<_T, _X> next(T& t, X& x, T& u, X& c, const _X& _x, const _X& p = _X(0))
-	{
-		const auto& [pv0, D0] = present_valuate(t, x, u, c);
-		auto F = [p, pv0, D0, u, c](_X f) { 
-			pwflat::curve F(f);  
-			return -p + pv0 + D0*f.present_value(u, c); 
+	// Cash flows a[j] + b[j] q at increasing times u[j] having present
+	// value price when q is the market quote. Quotes enter linearly so
+	// instruments are built once and repriced for any quote.
+	template<class T = double, class X = double>
+	struct instrument {
+		std::vector<T> u;
+		std::vector<X> a, b;
+		X price;
+
+		T maturity() const
+		{
+			return u.back();
+		}
+		X amount(size_t j, const X& q) const
+		{
+			return a[j] + b[j] * q;
+		}
+
+		X present_value(const pwflat::indexed_view<T, X>& f, const X& q) const
+		{
+			typename pwflat::indexed_view<T, X>::hint h;
+			X pv = 0;
+
+			for (size_t j = 0; j < u.size(); ++j) {
+				pv += amount(j, q) * f.discount(u[j], h);
+			}
+
+			return pv;
+		}
+		// quote repricing the instrument on f
+		X par(const pwflat::indexed_view<T, X>& f) const
+		{
+			typename pwflat::indexed_view<T, X>::hint h;
+			X A = 0, B = 0;
+
+			for (size_t j = 0; j < u.size(); ++j) {
+				X D = f.discount(u[j], h);
+				A += a[j] * D;
+				B += b[j] * D;
+			}
+
+			return (price - A) / B;
+		}
+
+		// 1 + q dcf at maturity for 1 today
+		static instrument deposit(const T& maturity, const X& dcf)
+		{
+			return instrument{ { maturity }, { X(1) }, { dcf }, X(1) };
+		}
+		// pay 1 at effective and receive 1 + q dcf at effective + period
+		static instrument fra(const T& effective, const T& period, const X& dcf)
+		{
+			return instrument{ { effective, effective + period }, { X(-1), X(1) }, { X(0), dcf }, X(0) };
+		}
+		// pay 1 at effective and receive q dcf[j] at u[j] and 1 at the last
+		static instrument swap(const T& effective, std::span<const T> u, std::span<const X> dcf)
+		{
+			if (u.size() != dcf.size() or u.empty()) {
+				throw std::invalid_argument("fms::bootstrap::instrument::swap: payment and day count sizes differ");
+			}
+			instrument i{ { effective }, { X(-1) }, { X(0) }, X(0) };
+			for (size_t j = 0; j < u.size(); ++j) {
+				i.u.push_back(u[j]);
+				i.a.push_back(j + 1 == u.size() ? X(1) : X(0));
+				i.b.push_back(dcf[j]);
+			}
+
+			return i;
+		}
+	};
+
+	// forward rate agreement on [effective, effective + period]
+	template<class T = double, class X = double>
+	struct fra {
+		T effective, period;
+		X dcf; // day count fraction of period
+
+		// simple compounded forward rate
+		X par(const pwflat::indexed_view<T, X>& f) const
+		{
+			return f.forward(effective, period, dcf);
+		}
+		instrument<T, X> cash_flows() const
+		{
+			return instrument<T, X>::fra(effective, period, dcf);
+		}
+	};
+
+	// par rates of fras in one vectorized pass
+	template<class T = double, class X = double>
+	inline void par(const pwflat::indexed_view<T, X>& f, std::span<const T> effective, std::span<const T> period,
+		std::span<const X> dcf, std::span<X> out)
+	{
+		f.forward(effective, period, dcf, out);
+	}
+
+	// Add one pillar per instrument at its maturity with the forward that
+	// reprices it. Cash flows up to the last pillar are valued once from
+	// the integral table and later ones are
+	// D_0 exp(-f (u - t_0)) where t_0 is the last pillar,
+	// so the cost is linear in the number of cash flows.
+	template<class T = double, class X = double>
+	class sequential {
+		pwflat::indexed<T, X> f;
+		std::vector<size_t> n; // solver iterations per pillar
+		X lo, hi; // bracket for forwards
+		X tol; // absolute present value tolerance
+	public:
+		sequential(const X& lo = X(-1), const X& hi = X(1), const X& tol = X(1e-14))
+			: lo(lo), hi(hi), tol(tol)
+		{ }
+
+		const pwflat::indexed<T, X>& curve() const
+		{
+			return f;
+		}
+		std::span<const size_t> iterations() const
+		{
+			return n;
+		}
+		// start a new curve keeping storage
+		void reset(size_t pillars = 0)
+		{
+			f.clear();
+			f.reserve(pillars);
+			n.clear();
+			n.reserve(pillars);
+		}
+
+		// Add pillar at maturity of i repricing it at quote q starting
+		// from x0, or the last forward if NaN, and return the forward.
+		X next(const instrument<T, X>& i, const X& q, X x0 = pwflat::NaN<X>())
+		{
+			size_t m = f.size();
+			T t0 = m ? f.time()[m - 1] : T(0);
+			X D0 = m ? exp(-f.integrals()[m - 1]) : X(1);
+
+			if (!(i.maturity() > t0)) {
+				throw std::invalid_argument("fms::bootstrap::sequential::next: instrument must mature after last pillar");
+			}
+
+			size_t j0 = std::upper_bound(i.u.begin(), i.u.end(), t0) - i.u.begin();
+			typename pwflat::indexed_view<T, X>::hint h;
+			X pv0 = -i.price;
+			for (size_t j = 0; j < j0; ++j) {
+				if (i.u[j] < 0) {
+					throw std::invalid_argument("fms::bootstrap::sequential::next: cash flow times must be nonnegative");
+				}
+				// D(0) = 1 even on an empty curve
+				pv0 += i.amount(j, q) * (i.u[j] == 0 ? X(1) : f.discount(i.u[j], h));
+			}
+			auto df = [&](X x) {
+				X y = pv0, dy = 0;
+				for (size_t j = j0; j < i.u.size(); ++j) {
+					T dt = i.u[j] - t0;
+					X c = i.amount(j, q) * D0 * exp(-x * dt);
+					y += c;
+					dy -= c * dt;
+				}
+				return std::pair(y, dy);
+			};
+
+			if (x0 != x0) {
+				x0 = m ? f.rate()[m - 1] : X(0);
+			}
+			auto [x, k] = root1d::newton_bracket(df, lo, hi, x0, tol);
+			f.push_back(i.maturity(), x);
+			f.extrapolate(x);
+			n.push_back(k);
+
+			return x;
+		}
+
+		// curve repricing instruments is[k] at quotes q[k], optional initial forwards x0
+		const pwflat::indexed<T, X>& solve(std::span<const instrument<T, X>> is, std::span<const X> q,
+			std::span<const X> x0 = {})
+		{
+			if (is.size() != q.size() or (!x0.empty() and x0.size() != q.size())) {
+				throw std::invalid_argument("fms::bootstrap::sequential::solve: instrument and quote sizes differ");
+			}
+
+			reset(is.size());
+			for (size_t k = 0; k < is.size(); ++k) {
+				next(is[k], q[k], x0.empty() ? pwflat::NaN<X>() : x0[k]);
+			}
+
+			return f;
+		}
+	};
+
+	// Bootstrap scenarios of quotes, row s of q holding quotes of is, into
+	// the rows of the scenario by pillar forward matrix x. With a pool the
+	// scenarios are split into chunks of grain rows, each having its own
+	// solver storage, and every scenario in a chunk warm starts from the
+	// forwards of the one before. If a scenario fails to solve the first
+	// exception is rethrown on the calling thread after running chunks end.
+	template<class T = double, class X = double>
+	inline void batch(std::span<const instrument<T, X>> is, std::span<const X> q, std::span<X> x,
+		parallel::pool* p = nullptr, size_t grain = 0)
+	{
+		size_t k = is.size();
+		if (k == 0 or q.size() % k != 0 or x.size() != q.size()) {
+			throw std::invalid_argument("fms::bootstrap::batch: quote and forward matrix sizes differ");
+		}
+		size_t m = q.size() / k; // scenarios
+
+		auto chunk = [&](size_t s0, size_t s1) {
+			sequential<T, X> s;
+			for (size_t i = s0; i < s1; ++i) {
+				auto x0 = i == s0 ? std::span<const X>{} : std::span<const X>(x.subspan((i - 1) * k, k));
+				const auto& f = s.solve(is, q.subspan(i * k, k), x0);
+				std::copy_n(f.rate().data(), k, x.begin() + i * k);
+			}
 		};
 
-		return std::pair(0, _x);
+		if (!p) {
+			chunk(0, m);
+		}
+		else {
+			if (grain == 0) {
+				grain = std::max<size_t>(1, m / (4 * p->size()));
+			}
+			size_t nc = (m + grain - 1) / grain;
+			parallel::for_each(iterable::take(nc, iterable::sequence<size_t>()), [&](size_t c) {
+				chunk(c * grain, std::min(m, (c + 1) * grain));
+			}, 1, *p);
+		}
+	}
+	// scenario by pillar forwards
+	template<class T = double, class X = double>
+	inline std::vector<X> batch(std::span<const instrument<T, X>> is, std::span<const X> q, parallel::pool* p = nullptr)
+	{
+		std::vector<X> x(q.size());
+		batch(is, q, std::span<X>(x), p);
+
+		return x;
+	}
+
+	// Fit all pillar forwards at once by Newton's method on instrument
+	// present values less prices, one instrument per pillar, so instruments
+	// may overlap or mature between pillars. Row k of the Jacobian is the
+	// gradient of instrument k from a pwflat::adjoint sweep. Instruments
+	// only see pillars up to their maturity so the Jacobian has upper
+	// bandwidth p, the most pillars an instrument reaches past its own row,
+	// and is factored in O(n^2 p). Forwards after the last pillar equal the last.
+	// The instruments, solution and factored Jacobian are kept as a base
+	// for rebootstrap.
+	template<class T = double, class X = double>
+	class global {
+		pwflat::indexed<T, X> f;
+		std::vector<T> t_; // pillars
+		std::vector<X> x, r, J, g; // forwards, residuals, Jacobian, gradient
+		lu::banded<X> LU;
+		std::vector<instrument<T, X>> is0; // base instruments
+		pwflat::portfolio<T, X> P; // a and b flows of base instruments
+		std::vector<X> pv, D; // of P
+		std::vector<X> x0_; // base forwards
+		lu::banded<X> LU0; // base Jacobian
+		std::vector<X> S; // Broyden steps
+		size_t p; // upper bandwidth
+		size_t n; // steps of last solve
+		size_t fallback; // rebootstraps needing Newton
+		X tol; // absolute present value tolerance
+		size_t max; // Newton steps
+
+		// set curve to forwards x
+		void set()
+		{
+			f.clear();
+			for (size_t i = 0; i < x.size(); ++i) {
+				f.push_back(t_[i], x[i]);
+			}
+			f.extrapolate(x.back());
+		}
+		// |r| or throw if not finite so NaN never passes for converged
+		static X norm(const X& r)
+		{
+			X a = std::fabs(r);
+			if (!std::isfinite(a)) {
+				throw std::runtime_error("fms::bootstrap::global: residual not finite");
+			}
+
+			return a;
+		}
+		// residuals and Jacobian at f, return max |r|
+		X evaluate(std::span<const instrument<T, X>> is, std::span<const X> q)
+		{
+			size_t m = x.size();
+			pwflat::adjoint<T, X> a(f);
+			X e = 0;
+
+			for (size_t k = 0; k < m; ++k) {
+				const auto& i = is[k];
+				a.reset();
+				for (size_t j = 0; j < i.u.size(); ++j) {
+					a.add(i.u[j], i.amount(j, q[k]));
+				}
+				r[k] = a.value() - i.price;
+				e = std::max(e, norm(r[k]));
+				a.gradient(g);
+				X* Jk = J.data() + k * m;
+				std::copy_n(g.begin(), m, Jk);
+				Jk[m - 1] += g[m]; // extrapolation
+			}
+
+			return e;
+		}
+		// residuals of base instruments at f from one discount per payment time
+		X residual(std::span<const X> q)
+		{
+			X e = 0;
+
+			P.present_value(f, pv, D);
+			for (size_t k = 0; k < r.size(); ++k) {
+				r[k] = pv[2 * k] + q[k] * pv[2 * k + 1] - is0[k].price;
+				e = std::max(e, norm(r[k]));
+			}
+
+			return e;
+		}
+		// Newton from x, continuing step count n
+		void newton(std::span<const instrument<T, X>> is, std::span<const X> q)
+		{
+			size_t m = x.size();
+
+			for (size_t k = 0; evaluate(is, q) > tol; ++k, ++n) {
+				if (k == max) {
+					throw std::runtime_error("fms::bootstrap::global: too many iterations");
+				}
+				LU.factor(J, m, p);
+				LU.solve(r);
+				for (size_t i = 0; i < m; ++i) {
+					x[i] -= r[i];
+				}
+				set();
+			}
+		}
+	public:
+		global(const X& tol = X(1e-14), size_t max = 20)
+			: p(0), n(0), fallback(0), tol(tol), max(max)
+		{ }
+
+		const pwflat::indexed<T, X>& curve() const
+		{
+			return f;
+		}
+		// steps of the last solve or rebootstrap
+		size_t iterations() const
+		{
+			return n;
+		}
+		// upper bandwidth of the Jacobian
+		size_t bandwidth() const
+		{
+			return p;
+		}
+		// present values less prices at the solution
+		std::span<const X> residuals() const
+		{
+			return r;
+		}
+		// row major d residual[k] / d forward[i] at the last Newton iterate
+		std::span<const X> jacobian() const
+		{
+			return J;
+		}
+
+		// Curve with pillars t repricing instruments is[k] at quotes q[k]
+		// starting from forwards x0, or 0 if empty.
+		const pwflat::indexed<T, X>& solve(std::span<const T> t, std::span<const instrument<T, X>> is,
+			std::span<const X> q, std::span<const X> x0 = {})
+		{
+			size_t m = t.size();
+			if (m == 0 or is.size() != m or q.size() != m or (!x0.empty() and x0.size() != m)) {
+				throw std::invalid_argument("fms::bootstrap::global::solve: pillar, instrument and quote sizes differ");
+			}
+
+			x0_.clear(); // no base until this solve succeeds
+			t_.assign(t.begin(), t.end());
+			if (x0.empty()) {
+				x.assign(m, X(0));
+			}
+			else {
+				x.assign(x0.begin(), x0.end());
+			}
+			r.resize(m);
+			J.resize(m * m);
+			g.resize(m + 1);
+			f.reserve(m);
+			set();
+
+			p = 0;
+			for (size_t k = 0; k < m; ++k) {
+				size_t i = std::min(f.index(is[k].maturity()), m - 1);
+				p = std::max(p, i > k ? i - k : 0);
+			}
+
+			n = 0;
+			newton(is, q);
+			x0_ = x;
+			LU0.factor(J, m, p);
+
+			is0.assign(is.begin(), is.end());
+			P = pwflat::portfolio<T, X>{};
+			for (const auto& i : is0) {
+				size_t nu = i.u.size();
+				P.add(take(nu, ptr(i.u.data())), take(nu, ptr(i.a.data())));
+				P.add(take(nu, ptr(i.u.data())), take(nu, ptr(i.b.data())));
+			}
+			P.compile();
+			pv.resize(P.size());
+			D.resize(P.times().size());
+
+			return f;
+		}
+
+		// Solve the base instruments at quotes q near the base quotes with
+		// at most steps Broyden steps from the base forwards, then Newton if
+		// residuals still exceed tolerance. The inverse Jacobian is J0^{-1}
+		// from the base factorization with rank one updates applied as
+		// products with earlier steps, so a step costs one pricing of the
+		// instruments and O(n (n + steps)) with no Jacobian or factorization.
+		// The first step is the chord step -J0^{-1} r. The base is unchanged.
+		const pwflat::indexed<T, X>& rebootstrap(std::span<const X> q, size_t steps = 4)
+		{
+			size_t m = x0_.size();
+			if (m == 0) {
+				throw std::logic_error("fms::bootstrap::global::rebootstrap: no base solve");
+			}
+			if (q.size() != m) {
+				throw std::invalid_argument("fms::bootstrap::global::rebootstrap: quote size differs");
+			}
+
+			auto dot = [m](const X* a, const X* b) {
+				X s = 0;
+				for (size_t i = 0; i < m; ++i) {
+					s += a[i] * b[i];
+				}
+				return s;
+			};
+
+			S.resize(m * steps);
+			x = x0_;
+			set();
+			for (n = 0; residual(q) > tol; ++n) {
+				if (n == steps) {
+					++fallback;
+					newton(is0, q);
+					break;
+				}
+				// z = -J_n^{-1} r
+				X* z = S.data() + n * m;
+				LU0.solve(r);
+				for (size_t i = 0; i < m; ++i) {
+					z[i] = -r[i];
+				}
+				if (n > 0) {
+					for (size_t j = 0; j + 1 < n; ++j) {
+						const X* sj = S.data() + j * m;
+						const X* sj1 = sj + m;
+						X a = dot(sj, z) / dot(sj, sj);
+						for (size_t i = 0; i < m; ++i) {
+							z[i] += a * sj1[i];
+						}
+					}
+					const X* sn = z - m;
+					X a = 1 - dot(sn, z) / dot(sn, sn);
+					for (size_t i = 0; i < m; ++i) {
+						z[i] /= a;
+					}
+				}
+				for (size_t i = 0; i < m; ++i) {
+					x[i] += z[i];
+				}
+				set();
+			}
+
+			return f;
+		}
+		// rebootstraps that fell back to Newton
+		size_t fallbacks() const
+		{
+			return fallback;
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_fra()
+	{
+		double t[] = { 1, 2, 3 };
+		double x[] = { .01, .02, .03 };
+		pwflat::indexed f(array(t), array(x));
+		fra<> f6x12{ .5, .5, .5 };
+		assert(fabs(f6x12.par(f) - (exp(.005) - 1) / .5) < 1e-15);
+		assert(fabs(f6x12.cash_flows().par(f) - f6x12.par(f)) < 1e-15);
+
+		std::vector<double> e = { 0, 1, 2 }, p = { 1, 1, 1 }, dcf = { 1, 1, 1 }, F(3);
+		par<double, double>(f, e, p, dcf, F);
+		for (size_t k = 0; k < 3; ++k) {
+			assert(fabs(F[k] - (exp(x[k]) - 1)) < 1e-15);
+		}
+
+		return 0;
 	}
 
+	// instruments maturing at .25, .5, 1, 2, 3, 5
+	inline std::vector<instrument<>> test_instruments()
+	{
+		using I = instrument<>;
+		std::vector<I> is;
 
-	/*
-	// p = pvi + Di * sum c * exp(-f(u - _u))
-	template<class F, class I, class T, class X>
-	inline std::pair<T,X> bootstrap(F& f, const I& i, const X& p)
+		is.push_back(I::deposit(.25, .25));
+		is.push_back(I::fra(.25, .25, .25));
+		is.push_back(I::fra(.5, .5, .5));
+		for (int n : { 2, 3, 5 }) {
+			std::vector<double> u, dcf;
+			for (int j = 1; j <= n; ++j) {
+				u.push_back(j);
+				dcf.push_back(1);
+			}
+			is.push_back(I::swap(0, u, dcf));
+		}
+
+		return is;
+	}
+
+	inline int test_sequential()
 	{
-		const auto& [_pv, _D] = present_value(f, i);
-		const auto& [_u, _x] = *f;
-		auto pv = [f,i,p,pv0](X x_) {
-			X pv_ = present_value(pwflat(x_), I(i), _u);
+		double t[] = { .25, .5, 1, 2, 3, 5 };
+		double x[] = { .01, .012, .015, .02, .022, .025 };
+		pwflat::indexed f(array(t), array(x));
+
+		auto is = test_instruments();
+		std::vector<double> q;
+		for (const auto& i : is) {
+			q.push_back(i.par(f));
+			assert(fabs(i.present_value(f, q.back()) - i.price) < 1e-15);
+		}
+
+		sequential<> s;
+		const auto& g = s.solve(is, q);
+		assert(6 == g.size());
+		for (size_t k = 0; k < 6; ++k) {
+			assert(g.time()[k] == t[k]);
+			assert(fabs(g.rate()[k] - x[k]) < 1e-13);
+			assert(fabs(is[k].present_value(g, q[k]) - is[k].price) < 1e-14);
+			assert(s.iterations()[k] < 10);
+		}
+
+		// warm start from the answer
+		s.solve(is, q, std::span<const double>(x));
+		for (size_t k = 0; k < 6; ++k) {
+			assert(s.iterations()[k] <= 2);
+		}
+
+		// first flow at time 0 on an empty curve
+		s.reset();
+		double x5 = s.next(is[5], q[5]);
+		assert(fabs(is[5].present_value(s.curve(), q[5])) < 1e-14);
+		assert(x5 > x[0] and x5 < x[5]);
 
-			return _D*pv_ - _pv - p;
+		// cash flow in the past
+		s.reset();
+		s.next(is[0], q[0]);
+		try {
+			s.next(instrument<>::fra(-.5, 1, 1), .01);
+			assert(false);
+		}
+		catch (const std::invalid_argument&) {
+		}
+
+		// instrument not extending the curve
+		s.solve(is, q);
+		try {
+			s.next(is[0], q[0]);
+			assert(false);
+		}
+		catch (const std::invalid_argument&) {
 		}
 
-		return [?,root1d(pv)];
+		return 0;
 	}
-	*/
+	inline int test_batch()
+	{
+		double t[] = { .25, .5, 1, 2, 3, 5 };
+		double x[] = { .01, .012, .015, .02, .022, .025 };
+		auto is = test_instruments();
+		size_t k = is.size(), m = 10;
 
-} // namespace fms
-	/*
-		struct fra {
-			T effective;
-			P period;
-			DCF dcf;
-			auto operator()(const Deflator& D, T t) const
-			{
-				return (D(t, effective)/D(t, effective + period) - 1)/dcf(effective, effective + period);
+		// parallel shifts and twists of x
+		std::vector<double> q, xs;
+		for (size_t i = 0; i < m; ++i) {
+			for (size_t j = 0; j < k; ++j) {
+				xs.push_back(x[j] + .001 * i - .0002 * i * j);
 			}
-		};
-	*/
\ No newline at end of file
+			pwflat::indexed f(array(t), ptr(xs.data() + i * k));
+			for (const auto& in : is) {
+				q.push_back(in.par(f));
+			}
+		}
+
+		auto x1 = batch<double, double>(is, q);
+		parallel::pool pool(2);
+		std::vector<double> x2(q.size());
+		batch<double, double>(is, q, x2, &pool, 3);
+		for (size_t i = 0; i < xs.size(); ++i) {
+			assert(fabs(x1[i] - xs[i]) < 1e-13);
+			assert(fabs(x2[i] - xs[i]) < 1e-13);
+		}
+
+		try {
+			batch<double, double>(is, std::span<const double>(q).first(k + 1));
+			assert(false);
+		}
+		catch (const std::invalid_argument&) {
+		}
+
+		// one unsolvable scenario is rethrown on this thread
+		auto q2 = q;
+		q2[4 * k + 2] = 1e6;
+		for (auto p : { (parallel::pool*)nullptr, &pool }) {
+			try {
+				batch<double, double>(is, q2, x2, p, 1);
+				assert(false);
+			}
+			catch (const std::runtime_error&) {
+			}
+		}
+		// pool still usable
+		batch<double, double>(is, q, x2, &pool, 1);
+		for (size_t i = 0; i < xs.size(); ++i) {
+			assert(fabs(x2[i] - xs[i]) < 1e-13);
+		}
+
+		return 0;
+	}
+	inline int test_global()
+	{
+		double t[] = { 1, 2, 3, 4 };
+		double x[] = { .01, .015, .02, .022 };
+		pwflat::indexed f(array(t), array(x), x[3]);
+		using I = instrument<>;
+
+		// 0x2 fra reaches past the deposit pillar and the deposit stops short of its own
+		std::vector<I> is;
+		is.push_back(I::fra(0, 2, 2));
+		is.push_back(I::deposit(.5, .5));
+		for (int n : { 3, 4 }) {
+			std::vector<double> u, dcf;
+			for (int j = 1; j <= n; ++j) {
+				u.push_back(j);
+				dcf.push_back(1);
+			}
+			is.push_back(I::swap(0, u, dcf));
+		}
+		std::vector<double> q;
+		for (const auto& i : is) {
+			q.push_back(i.par(f));
+		}
+
+		global<> s;
+		const auto& g = s.solve(t, is, q);
+		assert(1 == s.bandwidth());
+		assert(s.iterations() <= 5);
+		for (size_t k = 0; k < 4; ++k) {
+			assert(fabs(g.rate()[k] - x[k]) < 1e-13);
+			assert(fabs(s.residuals()[k]) <= 1e-14);
+		}
+
+		// Jacobian against central differences
+		double eps = 1e-6;
+		for (size_t i = 0; i < 4; ++i) {
+			double xp[] = { x[0], x[1], x[2], x[3] };
+			double xm[] = { x[0], x[1], x[2], x[3] };
+			xp[i] += eps;
+			xm[i] -= eps;
+			pwflat::indexed fp(array(t), array(xp), xp[3]);
+			pwflat::indexed fm(array(t), array(xm), xm[3]);
+			for (size_t k = 0; k < 4; ++k) {
+				double d = (is[k].present_value(fp, q[k]) - is[k].present_value(fm, q[k])) / (2 * eps);
+				assert(fabs(s.jacobian()[k * 4 + i] - d) < 1e-8);
+			}
+		}
+
+		// same as sequential when instruments match pillars
+		auto js = test_instruments();
+		double t2[] = { .25, .5, 1, 2, 3, 5 };
+		std::vector<double> q2;
+		for (const auto& i : js) {
+			q2.push_back(i.par(f));
+		}
+		sequential<> b;
+		b.solve(js, q2);
+		s.solve(t2, js, q2);
+		assert(0 == s.bandwidth());
+		assert(s.iterations() <= 5);
+		for (size_t k = 0; k < 6; ++k) {
+			assert(fabs(s.curve().rate()[k] - b.curve().rate()[k]) < 1e-13);
+		}
+
+		// NaN quote does not converge
+		q2[3] = std::numeric_limits<double>::quiet_NaN();
+		try {
+			s.solve(t2, js, q2);
+			assert(false);
+		}
+		catch (const std::runtime_error&) {
+		}
+
+		return 0;
+	}
+	inline int test_rebootstrap()
+	{
+		auto is = test_instruments();
+		double t[] = { .25, .5, 1, 2, 3, 5 };
+		double x[] = { .01, .012, .015, .02, .022, .025 };
+		pwflat::indexed f(array(t), array(x));
+		std::vector<double> q;
+		for (const auto& i : is) {
+			q.push_back(i.par(f));
+		}
+
+		global<> s;
+		try {
+			s.rebootstrap(q);
+			assert(false);
+		}
+		catch (const std::logic_error&) {
+		}
+		s.solve(t, is, q);
+
+		// par point bumps match a full solve
+		global<> full;
+		for (size_t k = 0; k < 6; ++k) {
+			auto qk = q;
+			qk[k] += .0001;
+			const auto& g = s.rebootstrap(qk);
+			assert(s.iterations() <= 3);
+			full.solve(t, is, qk);
+			for (size_t i = 0; i < 6; ++i) {
+				assert(fabs(g.rate()[i] - full.curve().rate()[i]) < 1e-13);
+			}
+		}
+		assert(0 == s.fallbacks());
+
+		// large move falls back to Newton
+		auto q2 = q;
+		for (auto& qk : q2) {
+			qk += .02;
+		}
+		s.rebootstrap(q2, 1);
+		assert(1 == s.fallbacks());
+		full.solve(t, is, q2);
+		for (size_t i = 0; i < 6; ++i) {
+			assert(fabs(s.curve().rate()[i] - full.curve().rate()[i]) < 1e-13);
+		}
+
+		// base is kept
+		s.rebootstrap(q);
+		assert(0 == s.iterations());
+
+		// NaN quote does not converge
+		q2 = q;
+		q2[2] = std::numeric_limits<double>::quiet_NaN();
+		try {
+			s.rebootstrap(q2);
+			assert(false);
+		}
+		catch (const std::runtime_error&) {
+		}
+
+		// failed solve leaves no base
+		s.solve(t, is, q);
+		double t2[] = { .25, .5 };
+		std::vector<instrument<>> is2 = { is[0], is[0] }; // neither depends on the second forward
+		try {
+			s.solve(t2, is2, std::vector<double>{ q[0], q[0] });
+			assert(false);
+		}
+		catch (const std::runtime_error&) {
+		}
+		try {
+			s.rebootstrap(q);
+			assert(false);
+		}
+		catch (const std::logic_error&) {
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
@@ -0,0 +1,204 @@
+// fms_buffer.h - evaluate upstream items once and replay them
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <vector>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// Items are pulled from i once, stored, and replayed to every copy.
+	// With window n > 0 only the last n items are kept so infinite
+	// iterables can be buffered. Storage comes from a memory resource,
+	// e.g. a std::pmr::unsynchronized_pool_resource shared by buffers.
+	template<input_iterable I>
+	class buffer {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using difference_type = ptrdiff_t;
+		using value_type = typename I::value_type;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+	private:
+		static constexpr size_t npos = -1;
+
+		struct state {
+			I i; // next item to pull
+			std::pmr::vector<value_type> v;
+			size_t n; // window, 0 for all
+			size_t pulled, hits, misses;
+
+			state(const I& i, size_t n, std::pmr::memory_resource* r)
+				: i(i), v(r), n(n), pulled(0), hits(0), misses(0)
+			{
+				if (n) {
+					v.reserve(n);
+				}
+			}
+
+			void pull()
+			{
+				if (!n or v.size() < n) {
+					v.push_back(*i);
+				}
+				else {
+					v[pulled % n] = *i;
+				}
+				++i;
+				++pulled;
+				++misses;
+			}
+			const value_type& item(size_t k) const
+			{
+				if (!(k < pulled and (!n or k + n >= pulled))) {
+					throw std::out_of_range("fms::iterable::buffer: item not in window");
+				}
+
+				return v[n ? k % n : k];
+			}
+		};
+
+		std::shared_ptr<state> s;
+		size_t k; // item index
+	public:
+		buffer(const I& i, size_t n = 0, std::pmr::memory_resource* r = std::pmr::get_default_resource())
+			: s(std::allocate_shared<state>(std::pmr::polymorphic_allocator<state>(r), i, n, r)), k(0)
+		{ }
+		buffer(const buffer&) = default;
+		buffer& operator=(const buffer&) = default;
+		~buffer()
+		{ }
+
+		bool operator==(const buffer& b) const
+		{
+			return (!*this and !b) or (s == b.s and k == b.k);
+		}
+
+		buffer begin() const
+		{
+			return *this;
+		}
+		buffer end() const
+		{
+			buffer b{ *this };
+			b.k = npos;
+
+			return b;
+		}
+
+		explicit operator bool() const
+		{
+			return k < s->pulled or (k == s->pulled and s->i);
+		}
+		value_type operator*() const
+		{
+			if (k < s->pulled) {
+				++s->hits;
+			}
+			else {
+				s->pull();
+			}
+
+			return s->item(k);
+		}
+		buffer& operator++()
+		{
+			if (operator bool()) {
+				if (k == s->pulled) {
+					s->pull();
+				}
+				++k;
+			}
+
+			return *this;
+		}
+		buffer operator++(int)
+		{
+			buffer b{ *this };
+			operator++();
+
+			return b;
+		}
+
+		// items read from the buffer
+		size_t hits() const
+		{
+			return s->hits;
+		}
+		// items pulled from upstream
+		size_t misses() const
+		{
+			return s->misses;
+		}
+
+		// pull all items and return them as a contiguous iterable
+		auto array() const
+		{
+			if (s->n) {
+				throw std::logic_error("fms::iterable::buffer::array: buffer has a window");
+			}
+			while (s->i) {
+				s->pull();
+			}
+
+			return iterable::array(s->v.size(), s->v.data());
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_buffer()
+	{
+		{
+			int calls = 0;
+			auto f = [&calls](int i) { ++calls; return i * i; };
+			int x[] = { 1, 2, 3 };
+			auto b = buffer(apply(f, array(x)));
+			assert(3 == length(b));
+			assert(3 == calls);
+			assert(equal(b, apply([](int i) { return i * i; }, array(x))));
+			assert(3 == calls);
+			assert(3 == b.misses());
+			assert(3 == b.hits());
+			assert(9 == *back(b));
+			assert(b.end() == drop(3, b));
+			auto a = b.array();
+			static_assert(contiguous_iterable<decltype(a)>);
+			assert(3 == calls);
+			assert(equal(a, b));
+		}
+		{
+			// infinite stream keeping the last 2 items
+			std::pmr::unsynchronized_pool_resource pool;
+			auto b = buffer(sequence<int>(), 2, &pool);
+			auto b2 = drop(5, b);
+			assert(5 == *b2);
+			auto b3 = drop(4, b);
+			assert(4 == *b3);
+			assert(6 == b.misses());
+			assert(1 == b.hits());
+
+			// dropped out of the window
+			auto b1 = drop(1, b);
+			try {
+				*b1;
+				assert(false);
+			}
+			catch (const std::out_of_range&) {
+			}
+			try {
+				b.array();
+				assert(false);
+			}
+			catch (const std::logic_error&) {
+			}
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
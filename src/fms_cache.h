@@ -0,0 +1,330 @@
+// fms_cache.h - discount factors shared across a book
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#include <thread>
+#endif
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "fms_live.h"
+
+namespace fms::pwflat {
+
+	// which entry to replace when a shard is full
+	enum class eviction {
+		clock, // skip entries read since the hand last passed
+		fifo,  // oldest
+	};
+
+	// Discounts of a live curve keyed by (version, time). Entries for
+	// old versions never hit and are dropped when the curve changes.
+	// Keys are spread over shards each having a mutex for writers and a
+	// sequence number readers check, so hits take no lock and write
+	// nothing shared. Hits are counted per thread.
+	// A hit costs a little more than a discount from an indexed curve
+	// with tens of pillars, so only use it for curves with thousands of
+	// pillars or whose discounts cost more than a binary search and exp.
+	template<class T = double, class X = double>
+	class discount_cache {
+		struct entry {
+			std::atomic<size_t> version;
+			std::atomic<T> t;
+			std::atomic<X> D;
+			std::atomic<bool> ref; // read since hand passed
+		};
+		struct alignas(64) shard {
+			std::mutex m; // writers
+			std::atomic<size_t> seq = 0; // odd while writing
+			std::unique_ptr<std::atomic<size_t>[]> slot; // 1 + entry by linear probing, 0 if empty
+			std::unique_ptr<entry[]> e;
+			size_t used = 0;
+			size_t hand = 0;
+			size_t misses = 0, evictions = 0; // m locked
+		};
+		struct alignas(64) counter {
+			std::atomic<size_t> n = 0;
+		};
+
+		live<T, X>& f;
+		size_t cap; // entries per shard
+		size_t mask; // slots per shard - 1
+		eviction policy;
+		std::vector<std::unique_ptr<shard>> shards;
+		std::unique_ptr<counter[]> hits_; // by thread
+		size_t id; // subscription
+
+		static constexpr size_t stripes = 16;
+		static size_t stripe()
+		{
+			static std::atomic<size_t> next = 0;
+			thread_local size_t i = next.fetch_add(1, std::memory_order_relaxed) % stripes;
+
+			return i;
+		}
+
+		static size_t hash(size_t version, const T& t)
+		{
+			return (std::hash<T>{}(t) ^ version) * 0x9e3779b97f4a7c15ull;
+		}
+		shard& shard_of(size_t h) const
+		{
+			return *shards[(h >> 32) % shards.size()];
+		}
+		// slot of key or its empty slot
+		size_t find(const shard& s, size_t h, size_t version, const T& t) const
+		{
+			size_t j = h & mask;
+
+			for (size_t n = 0; n <= mask; ++n, j = (j + 1) & mask) {
+				size_t i = s.slot[j].load(std::memory_order_relaxed);
+				if (i == 0) {
+					break;
+				}
+				const entry& e = s.e[i - 1];
+				if (e.version.load(std::memory_order_relaxed) == version and e.t.load(std::memory_order_relaxed) == t) {
+					break;
+				}
+			}
+
+			return j;
+		}
+		// empty slot j and shift back later keys, s locked
+		void erase(shard& s, size_t j)
+		{
+			for (size_t i = (j + 1) & mask; ; i = (i + 1) & mask) {
+				size_t x = s.slot[i].load(std::memory_order_relaxed);
+				if (x == 0) {
+					break;
+				}
+				const entry& e = s.e[x - 1];
+				size_t home = hash(e.version.load(std::memory_order_relaxed), e.t.load(std::memory_order_relaxed)) & mask;
+				if (((i - home) & mask) >= ((i - j) & mask)) {
+					s.slot[j].store(x, std::memory_order_relaxed);
+					j = i;
+				}
+			}
+			s.slot[j].store(0, std::memory_order_relaxed);
+		}
+		// entry to replace, s locked
+		size_t victim(shard& s)
+		{
+			if (s.used < cap) {
+				return s.used++;
+			}
+			if (policy == eviction::clock) {
+				while (s.e[s.hand].ref.exchange(false, std::memory_order_relaxed)) {
+					s.hand = (s.hand + 1) % cap;
+				}
+			}
+			size_t i = s.hand;
+			s.hand = (s.hand + 1) % cap;
+			const entry& e = s.e[i];
+			size_t v = e.version.load(std::memory_order_relaxed);
+			T t = e.t.load(std::memory_order_relaxed);
+			erase(s, find(s, hash(v, t), v, t));
+			++s.evictions;
+
+			return i;
+		}
+	public:
+		// capacity is divided among shards
+		discount_cache(live<T, X>& f, size_t capacity = 1 << 16, size_t nshards = 16, eviction policy = eviction::clock)
+			: f(f), cap(std::max<size_t>(1, capacity / std::max<size_t>(1, nshards))), mask(std::bit_ceil(2 * cap) - 1), policy(policy),
+			  hits_(std::make_unique<counter[]>(stripes))
+		{
+			for (size_t i = 0; i < std::max<size_t>(1, nshards); ++i) {
+				shards.emplace_back(std::make_unique<shard>());
+				shards.back()->slot = std::make_unique<std::atomic<size_t>[]>(mask + 1);
+				shards.back()->e = std::make_unique<entry[]>(cap);
+			}
+			id = f.subscribe([this](const auto&) { clear(); });
+		}
+		discount_cache(const discount_cache&) = delete;
+		discount_cache& operator=(const discount_cache&) = delete;
+		~discount_cache()
+		{
+			f.unsubscribe(id);
+		}
+
+		// D(t) at the current version of the curve
+		X discount(const T& t)
+		{
+			size_t v = f.version();
+			size_t h = hash(v, t);
+			shard& s = shard_of(h);
+
+			size_t seq = s.seq.load(std::memory_order_acquire);
+			if (seq % 2 == 0) {
+				size_t i = s.slot[find(s, h, v, t)].load(std::memory_order_relaxed);
+				if (i != 0) {
+					entry& e = s.e[i - 1];
+					X D = e.D.load(std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (s.seq.load(std::memory_order_relaxed) == seq) {
+						if (!e.ref.load(std::memory_order_relaxed)) {
+							e.ref.store(true, std::memory_order_relaxed);
+						}
+						hits_[stripe()].n.fetch_add(1, std::memory_order_relaxed);
+
+						return D;
+					}
+				}
+			}
+
+			X D = f.view().discount(t);
+			{
+				std::lock_guard lock(s.m);
+				++s.misses;
+				size_t j = find(s, h, v, t);
+				if (s.slot[j].load(std::memory_order_relaxed) == 0) {
+					s.seq.fetch_add(1, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_release);
+					size_t i = victim(s);
+					entry& e = s.e[i];
+					e.version.store(v, std::memory_order_relaxed);
+					e.t.store(t, std::memory_order_relaxed);
+					e.D.store(D, std::memory_order_relaxed);
+					e.ref.store(false, std::memory_order_relaxed);
+					s.slot[find(s, h, v, t)].store(i + 1, std::memory_order_relaxed);
+					s.seq.fetch_add(1, std::memory_order_release);
+				}
+			}
+
+			return D;
+		}
+
+		// drop all entries
+		void clear()
+		{
+			for (auto& s : shards) {
+				std::lock_guard lock(s->m);
+				s->seq.fetch_add(1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				for (size_t j = 0; j <= mask; ++j) {
+					s->slot[j].store(0, std::memory_order_relaxed);
+				}
+				s->used = 0;
+				s->hand = 0;
+				s->seq.fetch_add(1, std::memory_order_release);
+			}
+		}
+
+		// number of entries
+		size_t size() const
+		{
+			size_t n = 0;
+
+			for (auto& s : shards) {
+				std::lock_guard lock(s->m);
+				n += s->used;
+			}
+
+			return n;
+		}
+		size_t capacity() const
+		{
+			return cap * shards.size();
+		}
+		size_t hits() const
+		{
+			size_t n = 0;
+
+			for (size_t i = 0; i < stripes; ++i) {
+				n += hits_[i].n.load(std::memory_order_relaxed);
+			}
+
+			return n;
+		}
+		size_t misses() const
+		{
+			size_t n = 0;
+
+			for (auto& s : shards) {
+				std::lock_guard lock(s->m);
+				n += s->misses;
+			}
+
+			return n;
+		}
+		size_t evictions() const
+		{
+			size_t n = 0;
+
+			for (auto& s : shards) {
+				std::lock_guard lock(s->m);
+				n += s->evictions;
+			}
+
+			return n;
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_cache()
+	{
+		double t[] = { 1, 2, 3 };
+		double x[] = { .01, .02, .03 };
+		live f(indexed(array(t), array(x), .04));
+		{
+			discount_cache c(f, 4, 1);
+			assert(4 == c.capacity());
+			assert(c.discount(1.5) == f.view().discount(1.5));
+			assert(c.discount(1.5) == f.view().discount(1.5));
+			assert(1 == c.misses() and 1 == c.hits() and 1 == c.size());
+
+			// clock keeps 1.5 which was read
+			c.discount(2.);
+			c.discount(2.5);
+			c.discount(3.);
+			c.discount(3.5);
+			assert(1 == c.evictions() and 4 == c.size());
+			c.discount(1.5);
+			assert(2 == c.hits());
+
+			// invalidated by update
+			f.update_pillar(0, .02);
+			assert(0 == c.size());
+			assert(c.discount(1.5) == f.view().discount(1.5));
+			assert(2 == c.hits() and 6 == c.misses());
+		}
+		{
+			discount_cache c(f, 2, 1, eviction::fifo);
+			c.discount(1.);
+			c.discount(2.);
+			c.discount(1.);
+			c.discount(3.); // evicts 1
+			c.discount(1.);
+			assert(1 == c.hits() and 4 == c.misses() and 2 == c.evictions());
+		}
+		{
+			// concurrent readers
+			discount_cache c(f, 64, 4);
+			std::vector<std::thread> ts;
+			std::atomic<int> bad = 0;
+			for (int i = 0; i < 4; ++i) {
+				ts.emplace_back([&]() {
+					for (int k = 0; k < 10'000; ++k) {
+						double u = (k % 100) * .05;
+						if (c.discount(u) != f.view().discount(u)) {
+							++bad;
+						}
+					}
+				});
+			}
+			for (auto& th : ts) {
+				th.join();
+			}
+			assert(0 == bad);
+			assert(40'000 == c.hits() + c.misses());
+			assert(c.size() <= c.capacity());
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
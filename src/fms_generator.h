@@ -0,0 +1,279 @@
+// fms_generator.h - iterable implemented by a coroutine
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#include <vector>
+#endif
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "fms_arena.h"
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// Coroutine frames come from an arena when the first coroutine
+	// parameter is fms::arena& followed by at most 8 parameters,
+	// otherwise from global new.
+	// generator<int> g(arena&, int n) { for (int i = 0; i < n; ++i) co_yield i; }
+	// Copies share the coroutine so advancing one advances all.
+	template<class T>
+	class generator {
+	public:
+		struct promise_type;
+		using handle = std::coroutine_handle<promise_type>;
+
+		struct promise_type {
+			const T* value = nullptr;
+			std::exception_ptr e;
+			size_t refs = 1;
+			bool started = false;
+
+			generator get_return_object()
+			{
+				return generator(handle::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+			std::suspend_always final_suspend() noexcept
+			{
+				return {};
+			}
+			// co_yield operand lives until the next resume
+			std::suspend_always yield_value(const T& t) noexcept
+			{
+				value = &t;
+
+				return {};
+			}
+			void return_void()
+			{ }
+			void unhandled_exception()
+			{
+				e = std::current_exception();
+			}
+
+			// frame is preceded by the arena it came from, or nullptr
+			static constexpr size_t header = alignof(std::max_align_t);
+
+			// any coroutine parameter after the arena
+			struct param {
+				template<class U>
+				param(const U&)
+				{ }
+			};
+
+			static void* operator new(size_t n)
+			{
+				void* p = ::operator new(n + header);
+				*static_cast<arena**>(p) = nullptr;
+
+				return static_cast<std::byte*>(p) + header;
+			}
+			// not a template so gcc pairs it with operator delete
+			static void* operator new(size_t n, arena& a,
+				param = 0, param = 0, param = 0, param = 0, param = 0, param = 0, param = 0, param = 0)
+			{
+				void* p = a.allocate(n + header, header);
+				*static_cast<arena**>(p) = &a;
+
+				return static_cast<std::byte*>(p) + header;
+			}
+			static void operator delete(void* q, size_t n)
+			{
+				void* p = static_cast<std::byte*>(q) - header;
+				arena* a = *static_cast<arena**>(p);
+
+				if (a) {
+					a->deallocate(p, n + header);
+				}
+				else {
+					::operator delete(p);
+				}
+			}
+		};
+
+	private:
+		handle h;
+		std::optional<T> t; // item before postfix increment
+
+		explicit generator(handle h)
+			: h(h)
+		{ }
+
+		// run up to first co_yield
+		void start() const
+		{
+			if (h and !h.promise().started) {
+				h.promise().started = true;
+				resume();
+			}
+		}
+		void resume() const
+		{
+			h.resume();
+			if (h.promise().e) {
+				std::rethrow_exception(std::exchange(h.promise().e, nullptr));
+			}
+		}
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using difference_type = ptrdiff_t;
+		using value_type = T;
+		using pointer = const T*;
+		using reference = const T&;
+
+		generator()
+			: h(nullptr)
+		{ }
+		generator(const generator& g)
+			: h(g.h), t(g.t)
+		{
+			if (h) {
+				++h.promise().refs;
+			}
+		}
+		generator(generator&& g) noexcept
+			: h(std::exchange(g.h, nullptr)), t(std::move(g.t))
+		{ }
+		generator& operator=(generator g) noexcept
+		{
+			std::swap(h, g.h);
+			std::swap(t, g.t);
+
+			return *this;
+		}
+		~generator()
+		{
+			if (h and 0 == --h.promise().refs) {
+				h.destroy();
+			}
+		}
+
+		bool operator==(const generator& g) const
+		{
+			return (!*this and !g) or (h == g.h and t == g.t);
+		}
+
+		generator begin() const
+		{
+			return *this;
+		}
+		generator end() const
+		{
+			return generator{};
+		}
+
+		explicit operator bool() const
+		{
+			if (t) {
+				return true;
+			}
+			start();
+
+			return h and !h.done();
+		}
+		value_type operator*() const
+		{
+			if (t) {
+				return *t;
+			}
+			start();
+
+			return *h.promise().value;
+		}
+		generator& operator++()
+		{
+			t.reset();
+			start();
+			if (h and !h.done()) {
+				resume();
+			}
+
+			return *this;
+		}
+		generator operator++(int)
+		{
+			generator g{ *this };
+			if (*this) {
+				g.t = operator*();
+			}
+			operator++();
+
+			return g;
+		}
+	};
+
+#ifdef _DEBUG
+
+	inline generator<int> test_iota(arena&, int n)
+	{
+		for (int i = 0; i < n; ++i) {
+			co_yield i;
+		}
+	}
+	inline generator<int> test_items(arena&, std::vector<int> v, const char*)
+	{
+		for (int i : v) {
+			co_yield i;
+		}
+	}
+	inline generator<int> test_iota(int n)
+	{
+		for (int i = 0; i < n; ++i) {
+			co_yield i;
+		}
+	}
+
+	inline int test_generator()
+	{
+		static_assert(input_iterable<generator<int>>);
+		{
+			arena a(1024);
+			{
+				auto g = test_iota(a, 3);
+				assert(a.used() > 0);
+				assert(g);
+				assert(0 == *g);
+				assert(0 == *g++);
+				assert(1 == *g);
+				assert(2 == *++g);
+				assert(!++g);
+				assert(g == g.end());
+			}
+			a.reset();
+			{
+				auto g = test_iota(a, 4);
+				assert(equal(g, take(4, sequence<int>())));
+			}
+			a.reset();
+			assert(4 == length(test_iota(a, 4)));
+			a.reset();
+			assert(3 == *back(test_iota(a, 4)));
+			a.reset();
+			{
+				// parameters of any type after the arena
+				auto g = test_items(a, { 1, 2 }, "");
+				assert(a.used() > 0);
+				assert(1 == *g);
+				assert(2 == *++g);
+			}
+		}
+		{
+			auto g = test_iota(2);
+			auto g2{ g };
+			assert(g == g2);
+			++g2; // shared
+			assert(1 == *g);
+			assert(0 == length(test_iota(0)));
+		}
+
+		return 0;
+	}
+
+#endif // _DEBUG
+
+} // namespace fms
@@ -4,11 +4,16 @@
 #include <cassert>
 #include <chrono>
 #endif
+#include <algorithm>
 #include <compare>
 #include <concepts>
 #include <functional>
 #include <iterator>
+#include <memory>
+#include <stdexcept>
 #include <type_traits>
+#include <utility>
+#include "fms_simd.h"
 
 namespace fms::iterable {
 
@@ -36,6 +41,42 @@ namespace fms::iterable {
 			{ i.end() } -> std::same_as<I>;
 		};
 
+	// input_iterable that knows how many items remain
+	template<class I>
+	concept sized_iterable = input_iterable<I>
+		&& requires (const I& i) {
+			{ i.size() } -> std::convertible_to<size_t>;
+		};
+
+	// input_iterable with constant time indexing and advance
+	template<class I>
+	concept random_access_iterable = input_iterable<I>
+		&& std::is_base_of_v<std::random_access_iterator_tag, typename I::iterator_category>
+		&& requires (I i, typename I::difference_type n) {
+			{ i[n] } -> std::convertible_to<typename I::value_type>;
+			{ i += n } -> std::same_as<I&>;
+		};
+
+	// random_access_iterable with items adjacent in memory
+	template<class I>
+	concept contiguous_iterable = random_access_iterable<I>
+		&& std::is_base_of_v<std::contiguous_iterator_tag, typename I::iterator_category>
+		&& requires (const I& i) {
+			{ i.data() } -> std::same_as<typename I::pointer>;
+		};
+
+	// sized_iterable that can be cut into [i, i + h) and [i + h, end)
+	template<class I>
+	concept splittable = sized_iterable<I> and random_access_iterable<I>
+		&& requires (const I& i, size_t h) {
+			{ i.split(h) } -> std::same_as<std::pair<I, I>>;
+		};
+
+	// computed items have no address so are at most random access
+	template<class C>
+	using computed_category = std::conditional_t<std::is_base_of_v<std::random_access_iterator_tag, C>,
+		std::random_access_iterator_tag, C>;
+
 	// All iterables begin alike...
 	template<input_iterable I>
 	inline I begin(I i)
@@ -55,6 +96,14 @@ namespace fms::iterable {
 	template<input_iterable I>
 	inline constexpr I back(I i)
 	{
+		if constexpr (sized_iterable<I> and random_access_iterable<I>) {
+			if (size_t n = i.size()) {
+				i += static_cast<typename I::difference_type>(n - 1);
+			}
+
+			return i;
+		}
+
 		while (I _i = i++)
 			if (!i)
 				return _i;
@@ -66,6 +115,18 @@ namespace fms::iterable {
 	template<input_iterable I, input_iterable J>
 	inline constexpr bool equal(I i, J j)
 	{
+		if constexpr (sized_iterable<I> and sized_iterable<J>) {
+			if (i.size() != j.size())
+				return false;
+		}
+
+		if constexpr (contiguous_iterable<I> and sized_iterable<I>
+			and contiguous_iterable<J> and sized_iterable<J>
+			and std::is_same_v<typename I::value_type, typename J::value_type>
+			and std::is_arithmetic_v<typename I::value_type>) {
+			return i.size() == simd::mismatch<typename I::value_type>(i.data(), j.data(), i.size());
+		}
+
 		while (i and j)
 			if (*i++ != *j++)
 				return false;
@@ -73,31 +134,107 @@ namespace fms::iterable {
 		return !i and !j;
 	}
 
+	// Compare items to x in their common type. Contiguous iterables of
+	// x's type are searched several items at a time by upto.
+	template<simd::cmp C, class T>
+	struct compare {
+		T x;
+
+		template<input_iterable I>
+		constexpr bool operator()(const I& i) const
+		{
+			using U = std::common_type_t<typename I::value_type, T>;
+
+			return simd::test<C, U>(U(*i), U(x));
+		}
+		// index of first match in p[0], ..., p[n - 1], or n
+		size_t find(const T* p, size_t n) const
+		{
+			return simd::find<C>(p, n, x);
+		}
+	};
+	template<class T>
+	inline constexpr compare<simd::cmp::lt, T> lt(const T& x)
+	{
+		return { x };
+	}
+	template<class T>
+	inline constexpr compare<simd::cmp::le, T> le(const T& x)
+	{
+		return { x };
+	}
+	template<class T>
+	inline constexpr compare<simd::cmp::gt, T> gt(const T& x)
+	{
+		return { x };
+	}
+	template<class T>
+	inline constexpr compare<simd::cmp::ge, T> ge(const T& x)
+	{
+		return { x };
+	}
+	template<class T>
+	inline constexpr compare<simd::cmp::eq, T> eq(const T& x)
+	{
+		return { x };
+	}
+	template<class T>
+	inline constexpr compare<simd::cmp::ne, T> ne(const T& x)
+	{
+		return { x };
+	}
+	template<class T>
+	inline constexpr compare<simd::cmp::nan, T> is_nan()
+	{
+		return { T(0) };
+	}
+
 	// return end or first item satisfying p
 	template<input_iterable I, class P>
 	inline constexpr I upto(I i, const P& p)
 	{
-		return !i or p(i) ? i : upto(++i, p);
+		if constexpr (contiguous_iterable<I> and sized_iterable<I>
+			and requires (size_t n) { { p.find(i.data(), n) } -> std::same_as<size_t>; }) {
+			return i += static_cast<typename I::difference_type>(p.find(i.data(), i.size()));
+		}
+
+		while (i and !p(i))
+			++i;
+
+		return i;
 	}
 
 	// return end or first false item
 	template<input_iterable I>
 	inline constexpr I all(I i)
 	{
-		return upto(i, [](I i) { return !*i; });
+		if constexpr (std::is_arithmetic_v<typename I::value_type>) {
+			return upto(i, eq(typename I::value_type(0)));
+		}
+		else {
+			return upto(i, [](I i) { return !*i; });
+		}
 	}
 	// return end or first true item
 	template<input_iterable I>
 	inline constexpr I any(I i)
 	{
-		return upto(i, [](I i) { return *i; });
+		if constexpr (std::is_arithmetic_v<typename I::value_type>) {
+			return upto(i, ne(typename I::value_type(0)));
+		}
+		else {
+			return upto(i, [](I i) { return *i; });
+		}
 	}
 
+	// Adapters hold callables by value so temporaries do not dangle.
+	// Stateless callables take no space.
+
 	// filter on predicate p
 	template<input_iterable I, class P>
 	class when {
 		I i;
-		const P& p;
+		[[no_unique_address]] P p;
 	public:
 		using iterator_category = std::input_iterator_tag;
 		using difference_type = typename I::difference_type;
@@ -111,7 +248,7 @@ namespace fms::iterable {
 
 		bool operator==(const when& w) const
 		{
-			return i == w.i and &p == &w.p;
+			return i == w.i;
 		}
 
 		when begin() const
@@ -123,6 +260,15 @@ namespace fms::iterable {
 			return when(i.end(), p);
 		}
 
+		const I& iter() const
+		{
+			return i;
+		}
+		const P& pred() const
+		{
+			return p;
+		}
+
 		explicit operator bool() const
 		{
 			return !!i;
@@ -152,7 +298,7 @@ namespace fms::iterable {
 	template<input_iterable I, class P>
 	class until {
 		I i;
-		const P& p;
+		[[no_unique_address]] P p;
 	public:
 		using iterator_category = std::input_iterator_tag;
 		using difference_type = typename I::difference_type;
@@ -166,7 +312,7 @@ namespace fms::iterable {
 
 		bool operator==(const until& u) const
 		{
-			return i == u.i and &p == &u.p;
+			return i == u.i;
 		}
 
 		until begin() const
@@ -178,6 +324,15 @@ namespace fms::iterable {
 			return until(upto(i, p), p);
 		}
 
+		const I& iter() const
+		{
+			return i;
+		}
+		const P& pred() const
+		{
+			return p;
+		}
+
 		explicit operator bool() const
 		{
 			return !p(i);
@@ -235,6 +390,10 @@ namespace fms::iterable {
 	template<input_iterable I>
 	inline constexpr size_t length(I i, size_t n = 0)
 	{
+		if constexpr (sized_iterable<I>) {
+			return n + i.size();
+		}
+
 		while (i++)
 			++n;
 
@@ -264,12 +423,15 @@ namespace fms::iterable {
 	}
 
 	// t, t + dt, ...
+	// Floating point items are accumulated by t += dt and t + n dt
+	// differs from n increments by rounding, so those are input only.
 	template<class T, class dT = T>
 	class sequence {
 		T t;
 		dT dt;
 	public:
-		using iterator_category = std::input_iterator_tag; // ??? bidirectional
+		using iterator_category = std::conditional_t<std::is_floating_point_v<T>,
+			std::input_iterator_tag, std::random_access_iterator_tag>;
 		using difference_type = dT;
 		using value_type = T;
 		using pointer = T*;
@@ -303,12 +465,24 @@ namespace fms::iterable {
 		{
 			return t;
 		}
+		value_type operator[](difference_type n) const
+			requires (!std::is_floating_point_v<T>)
+		{
+			return t + n * dt;
+		}
 		sequence& operator++()
 		{
 			t += dt;
 
 			return *this;
 		}
+		sequence& operator+=(difference_type n)
+			requires (!std::is_floating_point_v<T>)
+		{
+			t += n * dt;
+
+			return *this;
+		}
 		sequence operator++(int)
 		{
 			sequence s_{*this};
@@ -318,7 +492,6 @@ namespace fms::iterable {
 		}
 
 		// operator--
-		// operator+=
 		// operator-=
 		// operator+
 		// operator-
@@ -336,6 +509,15 @@ namespace fms::iterable {
 				assert(0 == *s++);
 				assert(1 == *s++);
 				assert(2 == *s++);
+				if constexpr (std::is_floating_point_v<T>) {
+					static_assert(!random_access_iterable<sequence>);
+				}
+				else {
+					static_assert(random_access_iterable<sequence>);
+					assert(6 == s[3]);
+					s += 3;
+					assert(6 == *s);
+				}
 			}
 			{
 				sequence<T> s(1,2);
@@ -349,7 +531,6 @@ namespace fms::iterable {
 				assert(3 == *s++);
 				assert(5 == *s++);
 			}
-			/*
 			{
 				using std::chrono::year_month_day;
 				using std::chrono::months;
@@ -369,7 +550,6 @@ namespace fms::iterable {
 				assert((*s).month() == std::chrono::month(4));
 				assert((*s).day() == std::chrono::day(1));
 			}
-			*/
 			
 
 			return 0;
@@ -393,9 +573,9 @@ namespace fms::iterable {
 	class ptr {
 		T* t;
 	public:
-		using iterator_category = std::input_iterator_tag; //!!! random access
+		using iterator_category = std::contiguous_iterator_tag;
 		using difference_type = ptrdiff_t;
-		using value_type = T;
+		using value_type = std::remove_cv_t<T>;
 		using pointer = T*;
 		using reference = T&;
 
@@ -430,6 +610,18 @@ namespace fms::iterable {
 		{
 			return *t;
 		}
+		value_type operator[](difference_type n) const
+		{
+			return t[n];
+		}
+		reference operator[](difference_type n)
+		{
+			return t[n];
+		}
+		pointer data() const
+		{
+			return t;
+		}
 		ptr& operator++()
 		{
 			if (operator bool()) {
@@ -438,6 +630,14 @@ namespace fms::iterable {
 
 			return *this;
 		}
+		ptr& operator+=(difference_type n)
+		{
+			if (operator bool()) {
+				t += n;
+			}
+
+			return *this;
+		}
 		ptr operator++(int)
 		{
 			ptr p_{*this};
@@ -474,6 +674,16 @@ namespace fms::iterable {
 				assert(++a); // no bounds checking
 				// assert(*a); // undefined behavior
 			}
+			{
+				int i[] = {1,2,3};
+				ptr a(i);
+				assert(3 == a[2]);
+				a[2] = 4;
+				assert(4 == i[2]);
+				a += 2;
+				assert(4 == *a);
+				assert(a.data() == i + 2);
+			}
 
 			return 0;
 		}
@@ -527,6 +737,52 @@ namespace fms::iterable {
 
 			return *this;
 		}
+
+		// Random access bases are sized or must have at least n items.
+		size_t size() const
+			requires sized_iterable<I> or random_access_iterable<I>
+		{
+			if constexpr (sized_iterable<I>) {
+				return std::min(n, static_cast<size_t>(i.size()));
+			}
+			else {
+				return i ? n : 0;
+			}
+		}
+		value_type operator[](difference_type k) const
+			requires random_access_iterable<I>
+		{
+			return i[k];
+		}
+		take& operator+=(difference_type k)
+			requires random_access_iterable<I>
+		{
+			if (std::cmp_less(k, 0)) {
+				throw std::invalid_argument("fms::iterable::take::operator+=: cannot move back");
+			}
+			if (static_cast<size_t>(k) > n) {
+				k = static_cast<difference_type>(n);
+			}
+			n -= k;
+			i += k;
+
+			return *this;
+		}
+		pointer data() const
+			requires contiguous_iterable<I>
+		{
+			return i.data();
+		}
+		std::pair<take, take> split(size_t h) const
+			requires random_access_iterable<I>
+		{
+			size_t m = size();
+			h = std::min(h, m);
+			I j{ i };
+			j += static_cast<difference_type>(h);
+
+			return std::pair(take(h, i), take(m - h, j));
+		}
 		take operator++(int)
 		{
 			take t_{*this};
@@ -566,6 +822,36 @@ namespace fms::iterable {
 				typename I::value_type p[] = { 1,2,3 };
 				auto t = take(3, ptr(p));
 				assert(3 == *back(t));
+				assert(3 == t.size());
+				assert(2 == t[1]);
+				assert(2 == *drop(1, t));
+				assert(!drop(4, t));
+				t += 2;
+				assert(3 == *t);
+				assert(1 == t.size());
+				assert(p + 2 == t.data());
+				try {
+					t += -1;
+					assert(false);
+				}
+				catch (const std::invalid_argument&) {
+				}
+			}
+			{
+				typename I::value_type p[] = { 1,2,3 };
+				auto [a, b] = take(3, ptr(p)).split(1);
+				assert(1 == a.size() and 1 == *a);
+				assert(2 == b.size() and 2 == *b);
+				auto [c, d] = a.split(2);
+				assert(1 == c.size() and 0 == d.size());
+			}
+			{
+				// empty base
+				auto t = take(3, ptr<typename I::value_type>());
+				assert(0 == t.size());
+				assert(0 == length(t));
+				auto [a, b] = t.split(1);
+				assert(0 == a.size() and 0 == b.size());
 			}
 
 			return 0;
@@ -576,6 +862,14 @@ namespace fms::iterable {
 	template<input_iterable I>
 	inline I drop(size_t n, I i)
 	{
+		if constexpr (random_access_iterable<I>) {
+			if constexpr (sized_iterable<I>) {
+				n = std::min(n, static_cast<size_t>(i.size()));
+			}
+
+			return i += static_cast<typename I::difference_type>(n);
+		}
+
 		while (n--)
 			++i;
 
@@ -696,6 +990,27 @@ namespace fms::iterable {
 		return take(N, ptr(t));
 	}
 
+	// [i, i + h) and [i + h, end) of a splittable or unbounded random access iterable
+	template<random_access_iterable I>
+	inline std::pair<I, I> split(const I& i, size_t h)
+	{
+		if constexpr (requires { i.split(h); }) {
+			return i.split(h);
+		}
+		else {
+			I j{ i };
+			j += static_cast<typename I::difference_type>(h);
+
+			return std::pair(i, j);
+		}
+	}
+	// balanced halves
+	template<splittable I>
+	inline std::pair<I, I> split(const I& i)
+	{
+		return i.split(i.size() / 2);
+	}
+
 	#ifdef _DEBUG
 	template<class T>
 	int test_array()
@@ -735,6 +1050,20 @@ namespace fms::iterable {
 			assert(equal(a,b));
 			assert(equal(a,array(i)));
 		}
+		{
+			using A = decltype(array<T>());
+			static_assert(contiguous_iterable<A>);
+			static_assert(sized_iterable<A>);
+			static_assert(!sized_iterable<ptr<T>>);
+
+			T i[] = {1,2,3};
+			T j[] = {4,5};
+			assert(!equal(array(i), array(j)));
+
+			auto t = take(3, array<T>());
+			assert(0 == length(t));
+			assert(!back(t));
+		}
 
 		return 0;
 	}
@@ -745,7 +1074,8 @@ namespace fms::iterable {
 		I i;
 		J j;
 	public:
-		using iterator_category = std::common_type_t<typename I::iterator_category, typename J::iterator_category>;
+		using iterator_category = computed_category<
+			std::common_type_t<typename I::iterator_category, typename J::iterator_category>>;
 		using difference_type = ptrdiff_t; // ???
 		using value_type = std::pair<typename I::value_type, typename J::value_type>;
 		using pointer = value_type*;
@@ -785,6 +1115,34 @@ namespace fms::iterable {
 
 			return *this;
 		}
+
+		size_t size() const
+			requires sized_iterable<I> and sized_iterable<J>
+		{
+			return std::min<size_t>(i.size(), j.size());
+		}
+		value_type operator[](difference_type n) const
+			requires random_access_iterable<I> and random_access_iterable<J>
+		{
+			return value_type(i[n], j[n]);
+		}
+		pair& operator+=(difference_type n)
+			requires random_access_iterable<I> and random_access_iterable<J>
+		{
+			i += n;
+			j += n;
+
+			return *this;
+		}
+		std::pair<pair, pair> split(size_t h) const
+			requires random_access_iterable<I> and random_access_iterable<J>
+				and (splittable<I> or splittable<J>)
+		{
+			auto [i0, i1] = iterable::split(i, h);
+			auto [j0, j1] = iterable::split(j, h);
+
+			return std::pair(pair(i0, j0), pair(i1, j1));
+		}
 		pair operator++(int)
 		{
 			pair p_{*this};
@@ -794,13 +1152,48 @@ namespace fms::iterable {
 		}
 	};
 
+#ifdef _DEBUG
+	template<class T>
+	inline int test_pair()
+	{
+		{
+			using A = decltype(array<T>());
+			static_assert(random_access_iterable<pair<A, A>>);
+			static_assert(!contiguous_iterable<pair<A, A>>);
+			static_assert(sized_iterable<pair<A, A>>);
+
+			T i[] = {1,2,3};
+			T j[] = {4,5};
+			auto p = pair(array(i), array(j));
+			assert(2 == length(p));
+			assert(std::pair(T(2), T(5)) == p[1]);
+			assert(std::pair(T(2), T(5)) == *back(p));
+			assert(!drop(2, p));
+
+			static_assert(splittable<decltype(p)>);
+			auto [p0, p1] = split(p);
+			assert(1 == length(p0) and std::pair(T(1), T(4)) == *p0);
+			assert(1 == length(p1) and std::pair(T(2), T(5)) == *p1);
+		}
+		{
+			// unbounded sequence splits along with sized array
+			T i[] = {1,2,3};
+			auto [p0, p1] = split(pair(array(i), sequence<T>(0)), 2);
+			assert(2 == length(p0));
+			assert(std::pair(T(3), T(2)) == *p1);
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
 	template<class F, input_iterable I,
 		class X = typename I::value_type, class Y = std::invoke_result_t<F, X>>
 	class apply {
-		const F& f;
+		[[no_unique_address]] F f;
 		I i;
 	public:
-		using iterator_category = typename I::iterator_category;
+		using iterator_category = computed_category<typename I::iterator_category>;
 		using difference_type = typename I::difference_type;
 		using value_type = Y;
 		using pointer = value_type*;
@@ -812,7 +1205,7 @@ namespace fms::iterable {
 
 		bool operator==(const apply& a) const
 		{
-			return &f == &a.f and i == a.i;
+			return i == a.i;
 		}
 
 		apply begin() const
@@ -824,6 +1217,15 @@ namespace fms::iterable {
 			return apply(f, i.end());
 		}
 
+		const I& iter() const
+		{
+			return i;
+		}
+		const F& func() const
+		{
+			return f;
+		}
+
 		explicit operator bool() const
 		{
 			return !!i;
@@ -838,6 +1240,31 @@ namespace fms::iterable {
 
 			return *this;
 		}
+
+		size_t size() const
+			requires sized_iterable<I>
+		{
+			return i.size();
+		}
+		value_type operator[](difference_type n) const
+			requires random_access_iterable<I>
+		{
+			return f(i[n]);
+		}
+		apply& operator+=(difference_type n)
+			requires random_access_iterable<I>
+		{
+			i += n;
+
+			return *this;
+		}
+		std::pair<apply, apply> split(size_t h) const
+			requires splittable<I>
+		{
+			auto [i0, i1] = i.split(h);
+
+			return std::pair(apply(f, i0), apply(f, i1));
+		}
 		apply operator++(int)
 		{
 			apply a_(f, i);
@@ -864,71 +1291,120 @@ namespace fms::iterable {
 			assert(0 == *++a);
 			assert(-1 == *++a);
 		}
+		{
+			int i[] = { 1,2,3 };
+			auto sq = [](int i) { return i * i; };
+			apply a(sq, array(i));
+			static_assert(random_access_iterable<decltype(a)>);
+			static_assert(!contiguous_iterable<decltype(a)>);
+			assert(3 == length(a));
+			assert(4 == a[1]);
+			assert(9 == *back(a));
+			assert(4 == *drop(1, a));
+
+			auto [a0, a1] = split(a);
+			assert(1 == length(a0) and 1 == *a0);
+			assert(2 == length(a1) and 4 == *a1);
+		}
 
 		return 0;
 	}
 #endif // _DEBUG
 
+	// running fold t0 f i0, (t0 f i0) f i1, ...
 	template<class F, input_iterable I,
 		class T = typename I::value_type>
 	class fold {
-		const F& f;
+		[[no_unique_address]] F f;
 		I i;
 		T t;
 	public:
-		using iterator_category = typename I::iterator_category;
+		using iterator_category = std::input_iterator_tag;
 		using difference_type = typename I::difference_type;
 		using value_type = T;
 		using pointer = value_type*;
 		using reference = value_type&;
 
 		fold(const F& f, const I& i, const T& t0)
-			: f(f), i(i), t(t0)
+			: f(f), i(i), t(i ? f(t0, *i) : t0)
 		{ }
 
 		bool operator==(const fold& a) const
 		{
-			return &f == &a.f and i == a.i and t == a.t;
+			return i == a.i;
 		}
 
 		fold begin() const
 		{
-			return fold(f, i, t);
+			return *this;
 		}
 		fold end() const
 		{
-			return fold(f, i.end(), t);
+			fold a_{ *this };
+			a_.i = i.end();
+
+			return a_;
 		}
 
 		explicit operator bool() const
 		{
 			return !!i;
 		}
-		auto operator*() const
+		value_type operator*() const
 		{
 			return t;
 		}
 		fold& operator++()
 		{
-			++i;
+			if (i and ++i) {
+				t = f(t, *i);
+			}
 
 			return *this;
 		}
 		fold operator++(int)
 		{
-			fold a_(f, i, t);
+			fold a_{ *this };
 			operator++();
 
 			return a_;
 		}
 	};
+#ifdef _DEBUG
+	inline int test_fold()
+	{
+		{
+			fold f(std::plus<int>{}, take(4, sequence<int>(1)), 0);
+			assert(f);
+			assert(1 == *f);
+			assert(3 == *++f);
+			assert(6 == *++f);
+			assert(10 == *++f);
+			assert(!++f);
+			assert(10 == *f);
+		}
+		{
+			int i[] = { 1,2,3 };
+			assert(6 == *back(fold(std::plus<int>{}, array(i), 0)));
+			assert(6 == *back(fold(std::multiplies<int>{}, array(i), 1)));
+			assert(7 == *fold(std::plus<int>{}, array<int>(), 7));
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
 
 	// make iterable from container
 	template<class C>
 	class container {
 		C::iterator b, e;
+
+		container(typename C::iterator b, typename C::iterator e)
+			: b(b), e(e)
+		{ }
 	public:
-		using iterator_category = typename C::iterator::iterator_category;
+		using iterator_category = std::conditional_t<std::contiguous_iterator<typename C::iterator>,
+			std::contiguous_iterator_tag, typename C::iterator::iterator_category>;
 		using difference_type = typename C::iterator::difference_type;
 		using value_type = typename C::iterator::value_type;
 		using pointer = typename C::iterator::pointer;
@@ -945,7 +1421,7 @@ namespace fms::iterable {
 
 		bool operator==(const container& c) const
 		{
-			return equal(*this, c);
+			return b == c.b and e == c.e;
 		}
 
 		container begin() const
@@ -955,7 +1431,7 @@ namespace fms::iterable {
 		container end() const
 		{
 			container c_{ *this };
-			c_.b = c_.end();
+			c_.b = e;
 
 			return c_;
 		}
@@ -980,6 +1456,36 @@ namespace fms::iterable {
 
 			return *this;
 		}
+
+		size_t size() const
+			requires std::random_access_iterator<typename C::iterator>
+		{
+			return static_cast<size_t>(e - b);
+		}
+		value_type operator[](difference_type n) const
+			requires std::random_access_iterator<typename C::iterator>
+		{
+			return b[n];
+		}
+		container& operator+=(difference_type n)
+			requires std::random_access_iterator<typename C::iterator>
+		{
+			b += std::min(n, e - b);
+
+			return *this;
+		}
+		pointer data() const
+			requires std::contiguous_iterator<typename C::iterator>
+		{
+			return std::to_address(b);
+		}
+		std::pair<container, container> split(size_t h) const
+			requires std::random_access_iterator<typename C::iterator>
+		{
+			auto m = b + std::min<difference_type>(h, e - b);
+
+			return std::pair(container(b, m), container(m, e));
+		}
 		container operator++(int)
 		{
 			auto c_{ *this };
@@ -1004,6 +1510,21 @@ namespace fms::iterable {
 				assert(2 == *i++);
 				assert(3 == *i);
 				assert(!++i);
+				assert(i == i2.end());
+			}
+			{
+				C c = { 1,2,3 };
+				container i(c);
+				assert(3 == length(i));
+				assert(2 == i[1]);
+				assert(3 == *back(i));
+				assert(!drop(4, i));
+				if constexpr (contiguous_iterable<container>) {
+					assert(i.data() == &c[0]);
+				}
+				auto [i0, i1] = iterable::split(i);
+				assert(1 == length(i0) and 1 == *i0);
+				assert(2 == length(i1) and 2 == *i1);
 			}
 
 			return 0;
@@ -1011,4 +1532,216 @@ namespace fms::iterable {
 #endif // _DEBUG
 	};
 
+	// pipeline stages: i | pipe::when(p) | pipe::apply(f) | pipe::take(n)
+	// Adjacent apply and when stages fuse into a single adapter.
+	namespace pipe {
+
+		// g(f(x))
+		template<class G, class F>
+		struct compose {
+			[[no_unique_address]] F f;
+			[[no_unique_address]] G g;
+
+			template<class X>
+			constexpr auto operator()(X&& x) const
+			{
+				return g(f(std::forward<X>(x)));
+			}
+		};
+
+		// p(i) and q(i)
+		template<class P, class Q>
+		struct both {
+			[[no_unique_address]] P p;
+			[[no_unique_address]] Q q;
+
+			template<class I>
+			constexpr bool operator()(const I& i) const
+			{
+				return p(i) and q(i);
+			}
+		};
+
+		template<class P>
+		struct when_t {
+			[[no_unique_address]] P p;
+		};
+		template<class P>
+		inline constexpr when_t<P> when(P p)
+		{
+			return when_t<P>{ std::move(p) };
+		}
+
+		template<class P>
+		struct until_t {
+			[[no_unique_address]] P p;
+		};
+		template<class P>
+		inline constexpr until_t<P> until(P p)
+		{
+			return until_t<P>{ std::move(p) };
+		}
+
+		template<class F>
+		struct apply_t {
+			[[no_unique_address]] F f;
+		};
+		template<class F>
+		inline constexpr apply_t<F> apply(F f)
+		{
+			return apply_t<F>{ std::move(f) };
+		}
+
+		struct take_t {
+			size_t n;
+		};
+		inline constexpr take_t take(size_t n)
+		{
+			return take_t{ n };
+		}
+
+		struct drop_t {
+			size_t n;
+		};
+		inline constexpr drop_t drop(size_t n)
+		{
+			return drop_t{ n };
+		}
+
+		template<input_iterable I, class P>
+		inline constexpr auto operator|(const I& i, when_t<P> w)
+		{
+			return iterable::when(i, std::move(w.p));
+		}
+		// when(when(i, p), q) = when(i, p and q)
+		template<input_iterable I, class P, class Q>
+		inline constexpr auto operator|(const iterable::when<I, P>& i, when_t<Q> w)
+		{
+			return iterable::when(i.iter(), both<P, Q>{ i.pred(), std::move(w.p) });
+		}
+
+		template<input_iterable I, class P>
+		inline constexpr auto operator|(const I& i, until_t<P> u)
+		{
+			return iterable::until(i, std::move(u.p));
+		}
+
+		template<input_iterable I, class F>
+		inline constexpr auto operator|(const I& i, apply_t<F> a)
+		{
+			return iterable::apply(std::move(a.f), i);
+		}
+		// apply(g, apply(f, i)) = apply(g o f, i)
+		template<class F, input_iterable I, class X, class Y, class G>
+		inline constexpr auto operator|(const iterable::apply<F, I, X, Y>& i, apply_t<G> a)
+		{
+			return iterable::apply(compose<G, F>{ i.func(), std::move(a.f) }, i.iter());
+		}
+
+		template<input_iterable I>
+		inline constexpr auto operator|(const I& i, take_t t)
+		{
+			return iterable::take(t.n, i);
+		}
+
+		template<input_iterable I>
+		inline constexpr auto operator|(const I& i, drop_t d)
+		{
+			return iterable::drop(d.n, i);
+		}
+
+#ifdef _DEBUG
+		inline int test()
+		{
+			{
+				auto even = [](auto i) { return *i % 2 == 0; };
+				auto sq = [](int i) { return i * i; };
+				auto s = sequence<int>() | when(even) | apply(sq) | take(3);
+				assert(equal(s, iterable::take(3, iterable::apply(sq, sequence<int>(0, 2)))));
+			}
+			{
+				auto inc = [](int i) { return i + 1; };
+				auto dbl = [](int i) { return 2 * i; };
+				auto s = sequence<int>() | apply(inc) | apply(dbl);
+				// fused into one apply over the sequence
+				static_assert(std::is_same_v<decltype(s.iter()), const sequence<int>&>);
+#ifndef _MSC_VER
+				static_assert(sizeof(s) == sizeof(sequence<int>));
+#endif
+				assert(2 == *s);
+				assert(4 == *++s);
+				assert(8 == s[2]);
+			}
+			{
+				auto odd = [](auto i) { return *i % 2 != 0; };
+				auto no3 = [](auto i) { return *i % 3 != 0; };
+				auto s = sequence<int>() | when(odd) | when(no3);
+				static_assert(std::is_same_v<decltype(s.iter()), const sequence<int>&>);
+				assert(1 == *s);
+				assert(5 == *++s);
+				assert(7 == *++s);
+				assert(11 == *++s);
+			}
+			{
+				int i[] = { 1,2,3,4 };
+				auto s = array(i) | drop(1) | until([](auto i) { return *i > 3; });
+				assert(equal(s, iterable::take(2, ptr(i + 1))));
+			}
+
+			return 0;
+		}
+#endif // _DEBUG
+
+	} // namespace pipe
+
+#ifdef _DEBUG
+	inline int test_upto()
+	{
+		{
+			double x[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+			auto a = array(x);
+			assert(4 == *upto(a, ge(4.)));
+			assert(4 == *upto(take(10, ptr(x)), ge(4.)));
+			assert(!upto(a, gt(10.)));
+			assert(5 == length(upto(a, gt(5.))));
+			assert(!all(a));
+			assert(1 == *any(a));
+			assert(!upto(a, is_nan<double>()));
+			x[7] = std::numeric_limits<double>::quiet_NaN();
+			assert(3 == length(upto(a, is_nan<double>())));
+			assert(!equal(a, a)); // NaN != NaN
+			// same predicates work on any iterable
+			assert(3 == *upto(sequence<int>(), ge(3)));
+		}
+		{
+			double x[] = { 1, 0, 1 };
+			double y[] = { 0, 0, 1 };
+			assert(0 == *all(array(x)));
+			assert(2 == length(all(array(x))));
+			assert(1 == *any(array(y)));
+			assert(1 == length(any(array(y))));
+			assert(!all(array(x) | pipe::drop(2)));
+			assert(equal(array(x), array(x)));
+			assert(!equal(array(x), array(y)));
+		}
+		{
+			// thresholds of another type are not truncated
+			double x[] = { .5, 1.5, 3.5, 4 };
+			assert(3.5 == *upto(array(x), gt(3)));
+			assert(!upto(array(x), eq(0)));
+			assert(.5 == *upto(array(x), ne(0)));
+			assert(!all(array(x)));
+			assert(.5 == *any(array(x)));
+			int i[] = { 1, 2, 3 };
+			assert(3 == *upto(array(i), gt(2.5)));
+			assert(!upto(array(i), eq(2.5)));
+			float f[] = { 0, .25f };
+			assert(.25f == *any(array(f)));
+			assert(.25f == *upto(array(f), ge(.1)));
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
 } // namespace fms
@@ -0,0 +1,134 @@
+// fms_live.h - indexed curve updated in place by market ticks
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "fms_pwflat.h"
+
+namespace fms::pwflat {
+
+	// Pillar updates patch the integral table from the changed pillar on
+	// and notify subscribers of the interval whose rate changed. Discounts
+	// at times after change::t0 are affected. Updates and reads are not
+	// synchronized with each other but version() can be read from any thread.
+	template<class T = double, class X = double>
+	class live {
+	public:
+		struct change {
+			size_t i;       // pillar index, size() for extrapolation
+			T t0, t1;       // rate changed on (t0, t1]
+			size_t version; // after the change
+		};
+		using callback = std::function<void(const change&)>;
+	private:
+		indexed<T, X> f;
+		std::atomic<size_t> version_;
+		std::vector<std::pair<size_t, callback>> subs;
+		size_t next; // subscription id
+	public:
+		live(const indexed<T, X>& f)
+			: f(f), version_(0), next(0)
+		{ }
+		live(const live&) = delete;
+		live& operator=(const live&) = delete;
+		~live()
+		{ }
+
+		const indexed<T, X>& curve() const
+		{
+			return f;
+		}
+		const indexed_view<T, X>& view() const
+		{
+			return f.view();
+		}
+		// incremented by every update
+		size_t version() const
+		{
+			return version_.load(std::memory_order_acquire);
+		}
+
+		// call c after every update and return id for unsubscribe
+		size_t subscribe(callback c)
+		{
+			subs.emplace_back(next, std::move(c));
+
+			return next++;
+		}
+		void unsubscribe(size_t id)
+		{
+			std::erase_if(subs, [id](const auto& s) { return s.first == id; });
+		}
+
+		// set rate of pillar i, i == size() for extrapolation
+		change update_pillar(size_t i, const X& x)
+		{
+			f.update_pillar(i, x);
+
+			const T* t = f.time().data();
+			size_t n = f.size();
+			change c{ i, i == 0 ? T(0) : t[i - 1], i < n ? t[i] : std::numeric_limits<T>::infinity(), 0 };
+			c.version = version_.fetch_add(1, std::memory_order_acq_rel) + 1;
+			for (const auto& [id, s] : subs) {
+				s(c);
+			}
+
+			return c;
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_live()
+	{
+		double t[] = { 1, 2, 3 };
+		double x[] = { .01, .02, .03 };
+		live f(indexed(array(t), array(x), .04));
+		assert(0 == f.version());
+
+		std::vector<live<>::change> cs;
+		size_t id = f.subscribe([&cs](const auto& c) { cs.push_back(c); });
+
+		double D1 = f.view().discount(1.5);
+		double D3 = f.view().discount(3.5);
+		auto c = f.update_pillar(2, .05);
+		assert(1 == f.version() and 1 == c.version);
+		assert(1 == cs.size() and 2 == cs[0].i and 2 == cs[0].t0 and 3 == cs[0].t1);
+		// before t0 unchanged
+		assert(D1 == f.view().discount(1.5));
+		assert(D3 > f.view().discount(3.5));
+		assert(.05 == f.view().value(2.5));
+
+		// same as building from scratch
+		double x2[] = { .02, .02, .05 };
+		f.update_pillar(0, .02);
+		indexed g(array(t), array(x2), .04);
+		for (double _t = 0; _t < 5; _t += .25) {
+			assert(f.view().integral(_t) == g.integral(_t));
+		}
+		assert(0 == cs.back().t0 and 1 == cs.back().t1);
+
+		f.update_pillar(3, .06);
+		assert(std::isinf(cs.back().t1) and 3 == cs.back().t0);
+		assert(.06 == f.view().value(4));
+
+		f.unsubscribe(id);
+		f.update_pillar(1, .03);
+		assert(3 == cs.size() and 4 == f.version());
+
+		try {
+			f.update_pillar(4, 0.);
+			assert(false);
+		}
+		catch (const std::out_of_range&) {
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
@@ -0,0 +1,131 @@
+// fms_lu.h - LU factorization of matrices with few entries above the diagonal
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace fms::lu {
+
+	// Doolittle LU without pivoting of a row major n x n matrix having
+	// upper bandwidth p, a[i][j] = 0 for j > i + p. Elimination keeps U
+	// inside the band so factoring costs O(n^2 p) and solving O(n (n + p)).
+	// The lower part is dense, as for sensitivities of discounts to
+	// every earlier forward.
+	template<class X = double>
+	class banded {
+		size_t n, p;
+		std::vector<X> a; // L below and U on and above the diagonal
+	public:
+		banded()
+			: n(0), p(0)
+		{ }
+		banded(std::span<const X> a, size_t n, size_t p)
+			: banded()
+		{
+			factor(a, n, p);
+		}
+
+		size_t size() const
+		{
+			return n;
+		}
+		size_t upper() const
+		{
+			return p;
+		}
+
+		// factor a keeping storage of previous factorizations
+		void factor(std::span<const X> a_, size_t n_, size_t p_)
+		{
+			if (a_.size() != n_ * n_) {
+				throw std::invalid_argument("fms::lu::banded::factor: matrix must be n x n");
+			}
+			n = n_;
+			p = std::min(p_, n ? n - 1 : 0);
+			a.assign(a_.begin(), a_.end());
+
+			for (size_t k = 0; k < n; ++k) {
+				X* ak = a.data() + k * n;
+				size_t j1 = std::min(n, k + p + 1);
+				if (ak[k] == 0 or !std::isfinite(ak[k])) {
+					throw std::runtime_error("fms::lu::banded::factor: zero pivot");
+				}
+				for (size_t i = k + 1; i < n; ++i) {
+					X* ai = a.data() + i * n;
+					X l = ai[k] / ak[k];
+					ai[k] = l;
+					for (size_t j = k + 1; j < j1; ++j) {
+						ai[j] -= l * ak[j];
+					}
+				}
+			}
+		}
+
+		// solve A x = b in place
+		void solve(std::span<X> b) const
+		{
+			if (b.size() != n) {
+				throw std::invalid_argument("fms::lu::banded::solve: size must match matrix");
+			}
+
+			for (size_t i = 1; i < n; ++i) {
+				const X* ai = a.data() + i * n;
+				for (size_t k = 0; k < i; ++k) {
+					b[i] -= ai[k] * b[k];
+				}
+			}
+			for (size_t i = n; i-- > 0; ) {
+				const X* ai = a.data() + i * n;
+				size_t j1 = std::min(n, i + p + 1);
+				for (size_t j = i + 1; j < j1; ++j) {
+					b[i] -= ai[j] * b[j];
+				}
+				b[i] /= ai[i];
+			}
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_banded()
+	{
+		// upper bandwidth 1
+		double A[] = {
+			4, 1, 0, 0,
+			1, 4, 1, 0,
+			2, 1, 4, 1,
+			1, 2, 1, 4,
+		};
+		double x[] = { 1, -2, 3, -4 };
+		std::vector<double> b(4, 0.);
+		for (size_t i = 0; i < 4; ++i) {
+			for (size_t j = 0; j < 4; ++j) {
+				b[i] += A[i * 4 + j] * x[j];
+			}
+		}
+
+		banded<> lu(A, 4, 1);
+		assert(4 == lu.size() and 1 == lu.upper());
+		lu.solve(b);
+		for (size_t i = 0; i < 4; ++i) {
+			assert(fabs(b[i] - x[i]) < 1e-14);
+		}
+
+		// zero pivot
+		double Z[] = { 0, 1, 1, 0 };
+		try {
+			banded<> z(Z, 2, 1);
+			assert(false);
+		}
+		catch (const std::runtime_error&) {
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
@@ -0,0 +1,349 @@
+// fms_merge.h - merge sorted iterables into one ordered stream
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// key of pair items, e.g. the time of (time, amount) cash flows
+	struct by_first {
+		template<class X>
+		constexpr auto operator()(const X& x) const
+		{
+			return x.first;
+		}
+	};
+
+	// Items of iterables sorted by k in ascending order. A binary heap
+	// of the current keys costs log N comparisons per item. Items with
+	// equal keys come in the order of the iterables.
+	// Copies share the iterables and heap until one of them advances,
+	// which then takes its own copy. Postfix increment returns the item
+	// before the increment ahead of the shared state, so *i++ and
+	// while (i++) do not copy the state.
+	template<input_iterable I, class K = std::identity>
+	class merge {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using difference_type = ptrdiff_t;
+		using value_type = typename I::value_type;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+		using key_type = std::decay_t<std::invoke_result_t<K, value_type>>;
+	private:
+		struct node {
+			key_type k;
+			size_t n; // index of iterable
+		};
+		struct state {
+			std::vector<I> is;
+			std::vector<node> h; // heap of nonempty iterables, least at front
+			[[no_unique_address]] K k;
+
+			// a comes after b
+			static bool after(const node& a, const node& b)
+			{
+				return b.k < a.k or (!(a.k < b.k) and b.n < a.n);
+			}
+			void sift_down(size_t m)
+			{
+				node a = h[m];
+				size_t n = h.size();
+
+				while (2 * m + 1 < n) {
+					size_t c = 2 * m + 1;
+					if (c + 1 < n and after(h[c], h[c + 1])) {
+						++c;
+					}
+					if (!after(a, h[c])) {
+						break;
+					}
+					h[m] = h[c];
+					m = c;
+				}
+				h[m] = a;
+			}
+			void next()
+			{
+				I& i = is[h.front().n];
+				if (++i) {
+					h.front().k = k(*i);
+				}
+				else {
+					h.front() = h.back();
+					h.pop_back();
+				}
+				if (!h.empty()) {
+					sift_down(0);
+				}
+			}
+		};
+
+		std::shared_ptr<state> s; // null at end
+		std::optional<value_type> t; // item before those of s
+
+		merge()
+		{ }
+	public:
+		merge(const std::vector<I>& is, K k = K{})
+			: s(std::make_shared<state>(state{ .is = is, .h = {}, .k = k }))
+		{
+			auto& h = s->h;
+			h.reserve(is.size());
+			for (size_t n = 0; n < is.size(); ++n) {
+				if (is[n]) {
+					h.push_back(node{ k(*is[n]), n });
+				}
+			}
+			for (size_t m = h.size() / 2; m-- > 0; ) {
+				s->sift_down(m);
+			}
+		}
+		merge(std::initializer_list<I> is, K k = K{})
+			: merge(std::vector<I>(is), k)
+		{ }
+		merge(const merge&) = default;
+		merge& operator=(const merge&) = default;
+		~merge()
+		{ }
+
+		bool operator==(const merge& m) const
+		{
+			if (!*this or !m) {
+				return !*this and !m;
+			}
+
+			return t.has_value() == m.t.has_value() and (s == m.s or s->is == m.s->is);
+		}
+
+		merge begin() const
+		{
+			return *this;
+		}
+		merge end() const
+		{
+			return merge{};
+		}
+
+		explicit operator bool() const
+		{
+			return t or (s and !s->h.empty());
+		}
+		value_type operator*() const
+		{
+			return t ? *t : *s->is[s->h.front().n];
+		}
+		merge& operator++()
+		{
+			if (t) {
+				t.reset();
+			}
+			else if (operator bool()) {
+				if (s.use_count() > 1) {
+					s = std::make_shared<state>(*s);
+				}
+				s->next();
+			}
+
+			return *this;
+		}
+		merge operator++(int)
+		{
+			merge m;
+			if (*this) {
+				m.t = operator*();
+			}
+			operator++();
+			m.s = s;
+
+			return m;
+		}
+
+		// number of iterables not exhausted
+		size_t active() const
+		{
+			return s ? s->h.size() : 0;
+		}
+	};
+
+	// Combine adjacent items having equal keys using f(item, item).
+	template<input_iterable I, class F, class K = std::identity>
+	class coalesce {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using difference_type = ptrdiff_t;
+		using value_type = typename I::value_type;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+	private:
+		I i; // first item after current
+		[[no_unique_address]] F f;
+		[[no_unique_address]] K k;
+		value_type t;
+		bool has;
+
+		void load()
+		{
+			has = static_cast<bool>(i);
+			if (has) {
+				t = *i;
+				auto k_ = k(t);
+				while (++i and k(*i) == k_) {
+					t = f(t, *i);
+				}
+			}
+		}
+	public:
+		coalesce(const I& i, F f, K k = K{})
+			: i(i), f(f), k(k), t{}, has(false)
+		{
+			load();
+		}
+		coalesce(const coalesce&) = default;
+		coalesce& operator=(const coalesce&) = default;
+		~coalesce()
+		{ }
+
+		bool operator==(const coalesce& c) const
+		{
+			return has == c.has and (!has or i == c.i);
+		}
+
+		coalesce begin() const
+		{
+			return *this;
+		}
+		coalesce end() const
+		{
+			coalesce c{ *this };
+			c.i = i.end();
+			c.has = false;
+
+			return c;
+		}
+
+		explicit operator bool() const
+		{
+			return has;
+		}
+		value_type operator*() const
+		{
+			return t;
+		}
+		coalesce& operator++()
+		{
+			load();
+
+			return *this;
+		}
+		coalesce operator++(int)
+		{
+			coalesce c{ *this };
+			operator++();
+
+			return c;
+		}
+	};
+
+	// first of items with equal keys
+	struct keep_first {
+		template<class X>
+		constexpr const X& operator()(const X& a, const X&) const
+		{
+			return a;
+		}
+	};
+
+	// sorted items of all iterables without repeated keys
+	template<input_iterable I, class K = std::identity>
+	inline auto set_union(const std::vector<I>& is, K k = K{})
+	{
+		return coalesce(merge(is, k), keep_first{}, k);
+	}
+
+	// sorted items of all iterables with items having equal keys combined by f
+	template<input_iterable I, class F, class K = std::identity>
+	inline auto coalesce_by_key(const std::vector<I>& is, F f, K k = K{})
+	{
+		return coalesce(merge(is, k), f, k);
+	}
+
+#ifdef _DEBUG
+	inline int test_merge()
+	{
+		{
+			int a[] = { 1, 4, 7 };
+			int b[] = { 2, 4, 8, 9 };
+			int c[] = { 0 };
+			auto m = merge({ array(a), array(b), array(c), take(0, ptr(a)) });
+			static_assert(input_iterable<decltype(m)>);
+			assert(3 == m.active());
+			int ab[] = { 0, 1, 2, 4, 4, 7, 8, 9 };
+			assert(equal(m, array(ab)));
+			assert(8 == length(m));
+			assert(9 == *back(m));
+			assert(m.end() == drop(8, m));
+			assert(3 == m.active());
+
+			// copies advance independently
+			auto m_ = m;
+			auto m0 = m_++;
+			assert(0 == *m0 and 0 == *m);
+			assert(1 == *m_);
+			assert(1 == *++m0);
+			assert(m0 == m_);
+			assert(2 == *++m_);
+			assert(1 == *m0);
+			assert(equal(m0, drop(1, array(ab))));
+			assert(equal(m, array(ab)));
+
+			auto u = set_union(std::vector{ array(a), array(b), array(c) });
+			int u_[] = { 0, 1, 2, 4, 7, 8, 9 };
+			assert(equal(u, array(u_)));
+			assert(u.end() == drop(7, u));
+		}
+		{
+			// equal keys stay in the order of the iterables
+			double t0[] = { 1, 2 };
+			double c0[] = { .1, .2 };
+			double t1[] = { 1, 3 };
+			double c1[] = { 1., 3. };
+			std::vector cfs = { pair(array(t0), array(c0)), pair(array(t1), array(c1)) };
+			auto m = merge(cfs, by_first{});
+			assert(std::pair(1., .1) == *m);
+			assert(std::pair(1., 1.) == *++m);
+			assert(std::pair(2., .2) == *++m);
+			assert(std::pair(3., 3.) == *++m);
+			assert(!++m);
+
+			// one cash flow per time
+			auto add = [](const auto& a, const auto& b) { return std::pair(a.first, a.second + b.second); };
+			auto c = coalesce_by_key(cfs, add, by_first{});
+			assert(std::pair(1., 1.1) == *c);
+			assert(std::pair(2., .2) == *++c);
+			assert(std::pair(3., 3.) == *++c);
+			assert(!++c);
+		}
+		{
+			// unbounded
+			auto m = merge({ sequence<int>(0, 2), sequence<int>(1, 2) });
+			assert(equal(take(5, m), take(5, sequence<int>())));
+			auto c = coalesce(merge({ sequence<int>(0, 2), sequence<int>(0, 3) }), std::plus<int>{});
+			assert(0 == *c);
+			assert(2 == *++c);
+			assert(3 == *++c);
+			assert(4 == *++c);
+			assert(12 == *++c); // 6 + 6
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
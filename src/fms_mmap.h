@@ -0,0 +1,288 @@
+// fms_mmap.h - iterable over a memory mapped binary file
+#pragma once
+#ifdef _DEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#endif
+#include <cerrno>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "fms_iterable.h"
+
+namespace fms {
+
+#ifdef _DEBUG
+	// temporary file unique to this process and call so test runs do not collide
+	inline std::filesystem::path test_path(const char* stem)
+	{
+		static std::atomic<unsigned> n = 0;
+#ifdef _WIN32
+		unsigned long pid = GetCurrentProcessId();
+#else
+		long pid = getpid();
+#endif
+
+		return std::filesystem::temp_directory_path()
+			/ (std::string(stem) + "_" + std::to_string(pid) + "_" + std::to_string(n++) + ".bin");
+	}
+#endif // _DEBUG
+
+	// access pattern hints
+	enum class advice {
+		normal,
+		sequential,
+		random,
+		willneed,
+		dontneed,
+	};
+
+	// page faults of this process
+	struct faults {
+		long minor, major;
+	};
+	inline faults page_faults()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS pmc{};
+		GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+
+		return faults{ static_cast<long>(pmc.PageFaultCount), 0 }; // not split
+#else
+		rusage ru{};
+		getrusage(RUSAGE_SELF, &ru);
+
+		return faults{ ru.ru_minflt, ru.ru_majflt };
+#endif
+	}
+
+	// Read only mapping of a file of T. Views are contiguous iterables
+	// that are valid for the lifetime of the mapping.
+	template<class T>
+	class mapped {
+		const std::byte* p;
+		size_t n; // bytes
+		faults f0;
+#ifdef _WIN32
+		HANDLE file, map;
+#endif
+		static void fail(const char* what)
+		{
+#ifdef _WIN32
+			throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), what);
+#else
+			throw std::system_error(errno, std::generic_category(), what);
+#endif
+		}
+	public:
+		using value_type = T;
+
+		mapped(const char* path, advice a = advice::normal)
+			: p(nullptr), n(0), f0(page_faults())
+		{
+#ifdef _WIN32
+			file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				a == advice::sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				fail(path);
+			}
+			LARGE_INTEGER size;
+			GetFileSizeEx(file, &size);
+			n = static_cast<size_t>(size.QuadPart);
+			map = nullptr;
+			if (n) {
+				map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (!map) {
+					CloseHandle(file);
+					fail(path);
+				}
+				p = static_cast<const std::byte*>(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+				if (!p) {
+					CloseHandle(map);
+					CloseHandle(file);
+					fail(path);
+				}
+			}
+#else
+			int fd = ::open(path, O_RDONLY);
+			if (fd < 0) {
+				fail(path);
+			}
+			struct stat st;
+			if (fstat(fd, &st) < 0) {
+				::close(fd);
+				fail(path);
+			}
+			n = static_cast<size_t>(st.st_size);
+			if (n) {
+				void* q = ::mmap(nullptr, n, PROT_READ, MAP_SHARED, fd, 0);
+				if (q == MAP_FAILED) {
+					::close(fd);
+					fail(path);
+				}
+				p = static_cast<const std::byte*>(q);
+			}
+			::close(fd); // mapping keeps the file open
+#endif
+			advise(a);
+		}
+		mapped(const mapped&) = delete;
+		mapped& operator=(const mapped&) = delete;
+		mapped(mapped&& m) noexcept
+			: p(std::exchange(m.p, nullptr)), n(std::exchange(m.n, 0)), f0(m.f0)
+#ifdef _WIN32
+			, file(std::exchange(m.file, INVALID_HANDLE_VALUE)), map(std::exchange(m.map, nullptr))
+#endif
+		{ }
+		~mapped()
+		{
+#ifdef _WIN32
+			if (p) {
+				UnmapViewOfFile(p);
+			}
+			if (map) {
+				CloseHandle(map);
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+			}
+#else
+			if (p) {
+				::munmap(const_cast<std::byte*>(p), n);
+			}
+#endif
+		}
+
+		// number of T in file
+		size_t size() const
+		{
+			return n / sizeof(T);
+		}
+		const T* data() const
+		{
+			return reinterpret_cast<const T*>(p);
+		}
+
+		// k items starting at item i
+		auto view(size_t i = 0, size_t k = -1) const
+		{
+			i = std::min(i, size());
+			k = std::min(k, size() - i);
+
+			return iterable::array(k, data() + i);
+		}
+		// column j of a column major file with c columns
+		auto column(size_t j, size_t c) const
+		{
+			if (j >= c) {
+				throw std::invalid_argument("fms::mapped::column: column index must be less than number of columns");
+			}
+			size_t rows = size() / c;
+
+			return view(j * rows, rows);
+		}
+
+		// hint how items [i, i + k) will be accessed
+		void advise(advice a, size_t i = 0, size_t k = -1) const
+		{
+			i = std::min(i, size());
+			k = std::min(k, size() - i);
+			if (!k) {
+				return;
+			}
+#ifdef _WIN32
+			if (a == advice::willneed or a == advice::sequential) {
+				WIN32_MEMORY_RANGE_ENTRY r{ const_cast<T*>(data() + i), k * sizeof(T) };
+				PrefetchVirtualMemory(GetCurrentProcess(), 1, &r, 0);
+			}
+#else
+			static const int adv[] = {
+				MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED, MADV_DONTNEED
+			};
+			// madvise needs a page aligned start
+			uintptr_t b = reinterpret_cast<uintptr_t>(data() + i);
+			uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+			uintptr_t b_ = b - b % page;
+			::madvise(reinterpret_cast<void*>(b_), k * sizeof(T) + (b - b_), adv[static_cast<int>(a)]);
+#endif
+		}
+
+		// process page faults since the file was mapped
+		faults page_faults() const
+		{
+			faults f = fms::page_faults();
+
+			return faults{ f.minor - f0.minor, f.major - f0.major };
+		}
+
+#ifdef _DEBUG
+		static int test()
+		{
+			auto path = test_path("fms_mmap_test");
+			std::vector<T> v(3 * 1000);
+			for (size_t i = 0; i < v.size(); ++i) {
+				v[i] = static_cast<T>(i);
+			}
+			{
+				std::ofstream os(path, std::ios::binary);
+				os.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+			}
+			{
+				mapped m(path.string().c_str(), advice::sequential);
+				assert(v.size() == m.size());
+				auto a = m.view();
+				static_assert(iterable::contiguous_iterable<decltype(a)>);
+				assert(iterable::equal(a, iterable::container(v)));
+				assert(iterable::equal(m.view(10, 5), iterable::take(5, iterable::sequence<T>(10))));
+				assert(iterable::equal(m.column(1, 3), iterable::take(1000, iterable::sequence<T>(1000))));
+				assert(0 == iterable::length(m.view(v.size() + 1)));
+				for (auto [j, c] : { std::pair(0, 0), std::pair(3, 3) }) {
+					try {
+						m.column(j, c);
+						assert(false);
+					}
+					catch (const std::invalid_argument&) {
+					}
+				}
+				m.advise(advice::random, 17, 100);
+				auto f = m.page_faults();
+				assert(f.minor >= 0 and f.major >= 0);
+			}
+			std::filesystem::remove(path);
+			{
+				try {
+					mapped m((path.string() + ".none").c_str());
+					assert(false);
+				}
+				catch (const std::system_error&) {
+				}
+			}
+
+			return 0;
+		}
+#endif // _DEBUG
+	};
+
+} // namespace fms
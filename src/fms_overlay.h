@@ -0,0 +1,267 @@
+// fms_overlay.h - scenario curves as a base curve plus a closed form term
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <algorithm>
+#include <concepts>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "fms_pwflat.h"
+
+namespace fms::pwflat {
+
+	// forward g(t) added to a curve and G(t) = int_0^t g(s) ds
+	template<class O, class T = double>
+	concept curve_overlay = requires (const O& o, T t) {
+		{ o.value(t) };
+		{ o.integral(t) };
+	};
+
+	// g(t) = s
+	template<class T = double, class X = double>
+	struct shift {
+		X s;
+
+		constexpr X value(const T&) const
+		{
+			return s;
+		}
+		constexpr X integral(const T& t) const
+		{
+			return s * t;
+		}
+	};
+
+	// g(t) = s[i] on (b[i-1], b[i]], b[-1] = 0, and 0 after the last bucket
+	template<class T = double, class X = double>
+	class spread {
+		std::vector<T> b;
+		std::vector<X> s;
+	public:
+		spread(std::span<const T> b, std::span<const X> s)
+			: b(b.begin(), b.end()), s(s.begin(), s.end())
+		{
+			if (b.size() != s.size()) {
+				throw std::invalid_argument("fms::pwflat::spread: bucket and spread sizes differ");
+			}
+		}
+
+		X value(const T& t) const
+		{
+			size_t i = std::lower_bound(b.begin(), b.end(), t) - b.begin();
+
+			return t > 0 and i < s.size() ? s[i] : X(0);
+		}
+		X integral(const T& t) const
+		{
+			X G = 0;
+			T b0 = 0;
+
+			for (size_t i = 0; i < b.size() and b0 < t; ++i) {
+				G += s[i] * (std::min(t, b[i]) - b0);
+				b0 = b[i];
+			}
+
+			return G;
+		}
+	};
+
+	// g rises linearly from 0 at t0 to h at t1 and falls to 0 at t2
+	template<class T = double, class X = double>
+	struct key_rate {
+		T t0, t1, t2;
+		X h;
+
+		constexpr X value(const T& t) const
+		{
+			if (t <= t0 or t >= t2) {
+				return X(0);
+			}
+
+			return t <= t1 ? h * (t - t0) / (t1 - t0) : h * (t2 - t) / (t2 - t1);
+		}
+		constexpr X integral(const T& t) const
+		{
+			if (t <= t0) {
+				return X(0);
+			}
+			if (t <= t1) {
+				return h * (t - t0) * (t - t0) / (2 * (t1 - t0));
+			}
+			if (t <= t2) {
+				return h * ((t1 - t0) / 2 + (t - t1) - (t - t1) * (t - t1) / (2 * (t2 - t1)));
+			}
+
+			return h * (t2 - t0) / 2;
+		}
+	};
+
+	// sum of overlays
+	template<class A, class B>
+	struct compose {
+		A a;
+		B b;
+
+		template<class T>
+		constexpr auto value(const T& t) const
+		{
+			return a.value(t) + b.value(t);
+		}
+		template<class T>
+		constexpr auto integral(const T& t) const
+		{
+			return a.integral(t) + b.integral(t);
+		}
+	};
+	template<curve_overlay A, curve_overlay B>
+	inline constexpr compose<A, B> operator+(const A& a, const B& b)
+	{
+		return compose<A, B>{ a, b };
+	}
+
+	// Base curve plus overlay o. The base is not copied so its memory
+	// stays shared and warm across scenarios.
+	template<curve_overlay O, class T = double, class X = double>
+	class overlay {
+		indexed_view<T, X> f;
+		O o;
+	public:
+		using hint = typename indexed_view<T, X>::hint;
+
+		overlay(const indexed_view<T, X>& f, const O& o)
+			: f(f), o(o)
+		{ }
+
+		const indexed_view<T, X>& base() const
+		{
+			return f;
+		}
+		const O& term() const
+		{
+			return o;
+		}
+
+		X value(const T& t) const
+		{
+			return f.value(t) + o.value(t);
+		}
+		X forward(const T& t) const
+		{
+			return value(t);
+		}
+		X integral(const T& t) const
+		{
+			return f.integral(t) + o.integral(t);
+		}
+		X integral(const T& t, hint& h) const
+		{
+			return f.integral(t, h) + o.integral(t);
+		}
+		X integral(const T& t, const T& t0) const
+		{
+			return integral(t) - integral(t0);
+		}
+		X discount(const T& t) const
+		{
+			return exp(-integral(t));
+		}
+		X discount(const T& t, hint& h) const
+		{
+			return exp(-integral(t, h));
+		}
+		X discount(const T& t, const T& t0) const
+		{
+			return exp(-integral(t, t0));
+		}
+		X spot(const T& t) const
+		{
+			// overlays need not be flat before the first pillar
+			return t > 0 ? integral(t) / t : value(t);
+		}
+
+		// batch discounts at u
+		void discount(std::span<const T> u, std::span<X> out) const
+		{
+			if (u.size() != out.size()) {
+				throw std::invalid_argument("fms::pwflat::overlay::discount: input and output sizes differ");
+			}
+			hint h;
+			for (size_t k = 0; k < u.size(); ++k) {
+				out[k] = -integral(u[k], h);
+			}
+			simd::exp(out.data(), out.data(), out.size());
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_overlay()
+	{
+		double t[] = { 1, 2, 3 };
+		double x[] = { .01, .02, .03 };
+		indexed f(array(t), array(x), .04);
+		{
+			// same as shifting every rate
+			double xs[] = { .02, .03, .04 };
+			indexed g(array(t), array(xs), .05);
+			overlay s(f, shift{ .01 });
+			for (double u = 0; u < 5; u += .25) {
+				assert(fabs(s.value(u) - g.value(u)) < 1e-15);
+				assert(fabs(s.integral(u) - g.integral(u)) < 1e-15);
+				assert(fabs(s.discount(u) - g.discount(u)) < 1e-15);
+			}
+		}
+		{
+			// integral of key rate matches trapezoid rule
+			key_rate k{ 1., 2., 4., .001 };
+			assert(0 == k.value(1) and .001 == k.value(2) and 0 == k.value(4));
+			assert(.0005 == k.value(3));
+			double G = 0, du = 1e-4;
+			for (double u = 0; u < 5; u += du) {
+				G += (k.value(u) + k.value(u + du)) * du / 2;
+				assert(fabs(G - k.integral(u + du)) < 1e-9);
+			}
+			assert(fabs(k.integral(10) - .0015) < 1e-15);
+		}
+		{
+			// spot averages the overlay before the first pillar
+			overlay k(f, key_rate{ 0., .5, 1., .01 });
+			assert(fabs(k.spot(.5) - .015) < 1e-15);
+			assert(fabs(k.spot(.25) - k.integral(.25) / .25) < 1e-15);
+			double b[] = { .5, 1 };
+			double s[] = { .01, .02 };
+			overlay sp(f, spread<>(b, s));
+			assert(fabs(sp.spot(.75) - (.01 * .75 + .01 * .5 + .02 * .25) / .75) < 1e-15);
+		}
+		{
+			double b[] = { 1, 3 };
+			double s[] = { .01, .02 };
+			spread<> sp(b, s);
+			assert(.01 == sp.value(.5) and .01 == sp.value(1) and .02 == sp.value(2) and 0 == sp.value(4));
+			assert(fabs(sp.integral(2) - .03) < 1e-15);
+			assert(fabs(sp.integral(9) - .05) < 1e-15);
+
+			// composition
+			auto o = shift{ .001 } + key_rate{ 1., 2., 3., .0001 } + sp;
+			overlay v(f, o);
+			for (double u = 0; u < 5; u += .25) {
+				double I = f.integral(u) + .001 * u + key_rate{ 1., 2., 3., .0001 }.integral(u) + sp.integral(u);
+				assert(fabs(v.integral(u) - I) < 1e-15);
+			}
+			for (double u = .25; u < 5; u += .25) {
+				assert(fabs(v.spot(u) - v.integral(u) / u) < 1e-15);
+			}
+			assert(v.spot(0) == v.value(0));
+			std::vector<double> u = { .5, 1, 2.5, 4 }, D(4);
+			v.discount(u, D);
+			for (size_t i = 0; i < u.size(); ++i) {
+				assert(fabs(D[i] - v.discount(u[i])) < 1e-15);
+			}
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
@@ -0,0 +1,307 @@
+// fms_parallel.h - work stealing thread pool for splittable iterables
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#include <stdexcept>
+#endif
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "fms_iterable.h"
+
+namespace fms::parallel {
+
+	// Each worker pops tasks from the back of its own queue and steals
+	// from the front of the others when it runs dry. Threads waiting on
+	// results help by running tasks.
+	class pool {
+		struct queue {
+			std::mutex m;
+			std::deque<std::function<void()>> q;
+		};
+		std::vector<std::unique_ptr<queue>> qs;
+		std::vector<std::thread> ts;
+		std::atomic<size_t> queued;
+		std::atomic<size_t> next; // round robin for outside threads
+		std::mutex m;
+		std::condition_variable cv;
+		bool done;
+
+		// worker index of this thread in this pool, if any
+		size_t worker() const
+		{
+			return owner() == this ? index() : size_t(-1);
+		}
+		static const pool*& owner()
+		{
+			thread_local const pool* p = nullptr;
+
+			return p;
+		}
+		static size_t& index()
+		{
+			thread_local size_t i = -1;
+
+			return i;
+		}
+
+		bool pop(size_t i, std::function<void()>& f)
+		{
+			std::lock_guard lock(qs[i]->m);
+			auto& q = qs[i]->q;
+			if (q.empty()) {
+				return false;
+			}
+			f = std::move(q.back());
+			q.pop_back();
+
+			return true;
+		}
+		bool steal(size_t i, std::function<void()>& f)
+		{
+			std::lock_guard lock(qs[i]->m);
+			auto& q = qs[i]->q;
+			if (q.empty()) {
+				return false;
+			}
+			f = std::move(q.front());
+			q.pop_front();
+
+			return true;
+		}
+		void run(size_t i)
+		{
+			owner() = this;
+			index() = i;
+
+			while (true) {
+				if (!run_one()) {
+					std::unique_lock lock(m);
+					cv.wait(lock, [this]() { return done or queued > 0; });
+					if (done and queued == 0) {
+						return;
+					}
+				}
+			}
+		}
+	public:
+		pool(size_t n = std::thread::hardware_concurrency())
+			: queued(0), next(0), done(false)
+		{
+			n = std::max<size_t>(n, 1);
+			for (size_t i = 0; i < n; ++i) {
+				qs.emplace_back(std::make_unique<queue>());
+			}
+			for (size_t i = 0; i < n; ++i) {
+				ts.emplace_back([this, i]() { run(i); });
+			}
+		}
+		pool(const pool&) = delete;
+		pool& operator=(const pool&) = delete;
+		~pool()
+		{
+			{
+				std::lock_guard lock(m);
+				done = true;
+			}
+			cv.notify_all();
+			for (auto& t : ts) {
+				t.join();
+			}
+		}
+
+		// pool shared by the library
+		static pool& instance()
+		{
+			static pool p;
+
+			return p;
+		}
+
+		size_t size() const
+		{
+			return qs.size();
+		}
+
+		// f must not throw, for_each catches exceptions of its callable
+		void push(std::function<void()> f)
+		{
+			size_t i = worker();
+			if (i >= qs.size()) {
+				i = next++ % qs.size();
+			}
+			{
+				std::lock_guard lock(m);
+				++queued;
+			}
+			{
+				std::lock_guard lock(qs[i]->m);
+				qs[i]->q.push_back(std::move(f));
+			}
+			cv.notify_one();
+		}
+
+		// run a queued task, if any
+		bool run_one()
+		{
+			std::function<void()> f;
+			size_t n = qs.size();
+			size_t i = worker();
+			bool got = i < n and pop(i, f);
+
+			for (size_t k = 0; !got and k < n; ++k) {
+				got = steal((i + 1 + k) % n, f);
+			}
+			if (got) {
+				--queued;
+				f();
+			}
+
+			return got;
+		}
+	};
+
+	// Call f on every item of i. Splittable iterables are split in half
+	// until at most grain items remain and the pieces run on the pool.
+	// If f throws the remaining pieces are skipped and the first exception
+	// is rethrown on the calling thread after all pieces have finished.
+	template<iterable::input_iterable I, class F>
+	inline void for_each(I i, const F& f, size_t grain = 0, pool& p = pool::instance())
+	{
+		if constexpr (iterable::splittable<I>) {
+			if (grain == 0) {
+				grain = std::max<size_t>(1, i.size() / (8 * p.size()));
+			}
+
+			std::atomic<size_t> pending = 0;
+			std::atomic<bool> stop = false;
+			std::exception_ptr e; // first exception thrown by f
+			std::mutex m;
+			auto fail = [&]() {
+				std::lock_guard lock(m);
+				if (!e) {
+					e = std::current_exception();
+				}
+				stop = true;
+			};
+
+			std::function<void(const I&)> run = [&](const I& j) {
+				if (j.size() > grain) {
+					auto [j0, j1] = iterable::split(j);
+					++pending;
+					p.push([&run, &pending, &stop, &fail, j1]() {
+						try {
+							if (!stop) {
+								run(j1);
+							}
+						}
+						catch (...) {
+							fail();
+						}
+						--pending;
+					});
+					run(j0);
+				}
+				else {
+					for (I k{ j }; k and !stop; ++k) {
+						f(*k);
+					}
+				}
+			};
+
+			try {
+				run(i);
+			}
+			catch (...) {
+				fail();
+			}
+			// pieces refer to this frame
+			while (pending) {
+				if (!p.run_one()) {
+					std::this_thread::yield();
+				}
+			}
+			if (e) {
+				std::rethrow_exception(e);
+			}
+		}
+		else {
+			while (i) {
+				f(*i);
+				++i;
+			}
+		}
+	}
+
+#ifdef _DEBUG
+	inline int test()
+	{
+		{
+			pool p(3);
+			std::vector<int> v(100'000);
+			for (size_t k = 0; k < v.size(); ++k) {
+				v[k] = static_cast<int>(k % 10);
+			}
+			std::atomic<long long> s = 0;
+			for_each(iterable::container(v), [&s](int i) { s += i; }, 100, p);
+			assert(s == 45 * 10'000);
+
+			// write through index
+			std::vector<int> w(v.size());
+			auto kv = iterable::pair(iterable::take(v.size(), iterable::sequence<size_t>()), iterable::container(v));
+			for_each(kv, [&w](const auto& kv) { w[kv.first] = 2 * kv.second; }, 0, p);
+			for (size_t k = 0; k < v.size(); ++k) {
+				assert(w[k] == 2 * v[k]);
+			}
+		}
+		{
+			// nested
+			pool p(2);
+			std::atomic<int> n = 0;
+			for_each(iterable::take(10, iterable::sequence<int>()), [&](int) {
+				for_each(iterable::take(10, iterable::sequence<int>()), [&](int) { ++n; }, 1, p);
+			}, 1, p);
+			assert(100 == n);
+		}
+		{
+			// exceptions are rethrown on the caller after every piece finishes
+			pool p(2);
+			std::atomic<int> n = 0;
+			for (size_t grain : { 1, 10 }) {
+				n = 0;
+				try {
+					for_each(iterable::take(1000, iterable::sequence<int>()), [&n](int i) {
+						++n;
+						if (i == 500) {
+							throw std::runtime_error("fms::parallel::test: thrown");
+						}
+					}, grain, p);
+					assert(false);
+				}
+				catch (const std::runtime_error&) {
+				}
+				assert(n > 0 and n <= 1000);
+			}
+			// pool is still usable
+			n = 0;
+			for_each(iterable::take(1000, iterable::sequence<int>()), [&n](int) { ++n; }, 1, p);
+			assert(1000 == n);
+		}
+		{
+			// input iterables run on this thread
+			int n = 0;
+			for_each(iterable::take(5, iterable::when(iterable::sequence<int>(), [](auto) { return true; })), [&n](int) { ++n; });
+			assert(5 == n);
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
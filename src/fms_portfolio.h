@@ -0,0 +1,264 @@
+// fms_portfolio.h - value many cash flow streams in one sweep of a curve
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "fms_parallel.h"
+#include "fms_pwflat.h"
+
+namespace fms::pwflat {
+
+	// Payment times of all instruments are sorted and made unique once.
+	// Valuation computes one discount per unique time and gathers the
+	// present value of each instrument from them.
+	template<class T = double, class X = double>
+	class portfolio {
+		std::vector<T> u;      // unique sorted payment times
+		std::vector<T> t;      // payment time of each cash flow
+		std::vector<size_t> k; // index in u of each cash flow
+		std::vector<X> c;      // amount of each cash flow
+		std::vector<size_t> j; // cash flows of instrument i are [j[i], j[i + 1])
+		std::vector<size_t> last; // largest index in u of instrument cash flows
+		bool compiled;
+
+		// discounts at u on pieces of at least grain times
+		void discount(const indexed_view<T, X>& f, std::span<X> D, parallel::pool* p, size_t grain) const
+		{
+			if (p and u.size() > grain) {
+				size_t nb = (u.size() + grain - 1) / grain;
+				parallel::for_each(iterable::take(nb, iterable::sequence<size_t>()), [&](size_t b) {
+					size_t i = b * grain;
+					size_t n = std::min(grain, u.size() - i);
+					f.discount(std::span(u).subspan(i, n), D.subspan(i, n));
+				}, 1, *p);
+			}
+			else {
+				f.discount(u, D);
+			}
+		}
+		X gather(std::span<const X> D, size_t i) const
+		{
+			X pv = 0;
+
+			for (size_t m = j[i]; m < j[i + 1]; ++m) {
+				pv += c[m] * D[k[m]];
+			}
+
+			return pv;
+		}
+	public:
+		portfolio()
+			: j{ 0 }, compiled(true)
+		{ }
+		portfolio(const portfolio&) = default;
+		portfolio& operator=(const portfolio&) = default;
+		~portfolio()
+		{ }
+
+		// number of instruments
+		size_t size() const
+		{
+			return j.size() - 1;
+		}
+		// unique payment times
+		std::span<const T> times() const
+		{
+			return u;
+		}
+
+		// Add cash flows at times u with amounts c and return the
+		// instrument index. Cash flows before 0 are ignored as in
+		// present_value.
+		template<iterable::input_iterable U, iterable::input_iterable C>
+		size_t add(U u_, C c_)
+		{
+			while (u_ and c_) {
+				if (*u_ >= 0) {
+					t.push_back(*u_);
+					c.push_back(*c_);
+				}
+				++u_;
+				++c_;
+			}
+			j.push_back(t.size());
+			compiled = false;
+
+			return size() - 1;
+		}
+
+		// sort and index payment times
+		portfolio& compile()
+		{
+			if (!compiled) {
+				u = t;
+				std::sort(u.begin(), u.end());
+				u.erase(std::unique(u.begin(), u.end()), u.end());
+				k.resize(t.size());
+				for (size_t m = 0; m < t.size(); ++m) {
+					k[m] = std::lower_bound(u.begin(), u.end(), t[m]) - u.begin();
+				}
+				last.assign(size(), 0);
+				for (size_t i = 0; i < size(); ++i) {
+					for (size_t m = j[i]; m < j[i + 1]; ++m) {
+						last[i] = std::max(last[i], k[m]);
+					}
+				}
+				compiled = true;
+			}
+
+			return *this;
+		}
+
+		// Present value of each instrument using discounts D[k] at times()[k].
+		// With a pool the discounts are computed in buckets of at least grain
+		// times and instruments are gathered in parallel.
+		void present_value(const indexed_view<T, X>& f, std::span<X> pv, std::span<X> D,
+			parallel::pool* p = nullptr, size_t grain = 1 << 12) const
+		{
+			if (!compiled) {
+				throw std::logic_error("fms::pwflat::portfolio::present_value: call compile after add");
+			}
+			if (pv.size() != size() or D.size() != u.size()) {
+				throw std::invalid_argument("fms::pwflat::portfolio::present_value: wrong output size");
+			}
+
+			discount(f, D, p, grain);
+
+			if (p and size() > grain) {
+				parallel::for_each(iterable::take(size(), iterable::sequence<size_t>()), [&](size_t i) {
+					pv[i] = gather(D, i);
+				}, grain, *p);
+			}
+			else {
+				for (size_t i = 0; i < size(); ++i) {
+					pv[i] = gather(D, i);
+				}
+			}
+		}
+		// Update pv and D from a previous present_value after the curve
+		// changed only at times after t0, e.g. live::change::t0.
+		// Only discounts after t0 and instruments paying after t0 are recomputed.
+		void update(const indexed_view<T, X>& f, const T& t0, std::span<X> pv, std::span<X> D) const
+		{
+			if (!compiled) {
+				throw std::logic_error("fms::pwflat::portfolio::update: call compile after add");
+			}
+			if (pv.size() != size() or D.size() != u.size()) {
+				throw std::invalid_argument("fms::pwflat::portfolio::update: wrong output size");
+			}
+
+			size_t k0 = std::upper_bound(u.begin(), u.end(), t0) - u.begin();
+			f.discount(std::span(u).subspan(k0), D.subspan(k0));
+			for (size_t i = 0; i < size(); ++i) {
+				if (j[i] < j[i + 1] and last[i] >= k0) {
+					pv[i] = gather(D, i);
+				}
+			}
+		}
+
+		std::vector<X> present_value(const indexed_view<T, X>& f, parallel::pool* p = nullptr) const
+		{
+			std::vector<X> pv(size()), D(u.size());
+			present_value(f, pv, D, p);
+
+			return pv;
+		}
+
+		// Accumulate the portfolio into a for bucketed sensitivities
+		// and return its present value.
+		X present_value(adjoint<T, X>& a) const
+		{
+			if (!compiled) {
+				throw std::logic_error("fms::pwflat::portfolio::present_value: call compile after add");
+			}
+
+			std::vector<X> C(u.size(), X(0)); // net amount at each time
+			for (size_t m = 0; m < c.size(); ++m) {
+				C[k[m]] += c[m];
+			}
+			X pv = 0;
+			for (size_t i = 0; i < u.size(); ++i) {
+				pv += a.add(u[i], C[i]);
+			}
+
+			return pv;
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_portfolio()
+	{
+		double t[] = { 1, 2, 3, 4, 5 };
+		double x[] = { .01, .02, .03, .04, .05 };
+		indexed f(array(t), array(x));
+
+		double u0[] = { .5, 1, 1.5, 2 };
+		double c0[] = { .1, .1, .1, 1.1 };
+		double u1[] = { -1, 1, 2, 3 };
+		double c1[] = { 9, .2, .2, 1.2 };
+		double u2[] = { 1.5, 4.5 };
+		double c2[] = { 1, -1 };
+
+		portfolio p;
+		assert(0 == p.add(array(u0), array(c0)));
+		assert(1 == p.add(array(u1), array(c1)));
+		assert(2 == p.add(array(u2), array(c2)));
+		assert(3 == p.add(array<double>(), array<double>()));
+		assert(4 == p.size());
+		try {
+			p.present_value(f);
+			assert(false);
+		}
+		catch (const std::logic_error&) {
+		}
+		p.compile();
+		assert(6 == p.times().size()); // .5, 1, 1.5, 2, 3, 4.5
+
+		auto pv = p.present_value(f);
+		assert(fabs(pv[0] - present_value(array(t), array(x), array(u0), array(c0)).first) < 1e-15);
+		assert(fabs(pv[1] - present_value(array(t), array(x), array(u1), array(c1)).first) < 1e-15);
+		assert(fabs(pv[2] - (f.discount(1.5) - f.discount(4.5))) < 1e-15);
+		assert(0 == pv[3]);
+
+		// parallel with tiny buckets
+		parallel::pool pool(2);
+		auto pv2 = p.present_value(f, &pool);
+		std::vector<double> pv3(p.size()), D(p.times().size());
+		p.present_value(f, pv3, D, &pool, 1);
+		for (size_t i = 0; i < p.size(); ++i) {
+			assert(pv[i] == pv2[i] and pv[i] == pv3[i]);
+		}
+		assert(D[1] == f.discount(1.));
+
+		// incremental update after a tick at pillar 2, rate on (2, 3]
+		indexed g{ f };
+		g.update_pillar(2, .05);
+		p.update(g, 2., pv3, D);
+		auto pv4 = p.present_value(g);
+		for (size_t i = 0; i < p.size(); ++i) {
+			assert(pv3[i] == pv4[i]);
+		}
+		assert(pv3[0] == pv[0]); // pays by 2
+
+		// sensitivities of the whole book
+		adjoint a(f);
+		double pv_ = p.present_value(a);
+		assert(fabs(pv_ - (pv[0] + pv[1] + pv[2])) < 1e-14);
+		adjoint b(f);
+		b.add(array(u0), array(c0));
+		b.add(array(u1) | pipe::drop(1), array(c1) | pipe::drop(1));
+		b.add(array(u2), array(c2));
+		auto ga = a.gradient(), gb = b.gradient();
+		for (size_t i = 0; i < ga.size(); ++i) {
+			assert(fabs(ga[i] - gb[i]) < 1e-14);
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
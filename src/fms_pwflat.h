@@ -1,7 +1,13 @@
 // fms_pwflat.cpp - piecewise flat curve
+#pragma once
 #include <math.h>
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
 #include "fms_iterable.h"
 
 using namespace fms::iterable;
@@ -16,6 +22,19 @@ namespace fms::pwflat {
 		class _T = typename T::value_type, class _X = typename X::value_type>
 	inline std::pair<_T,_X> valuate(T& t, X& x, const _T& _t, const _X& _x = NaN<_X>())
 	{
+		if constexpr (contiguous_iterable<T> and sized_iterable<T> and random_access_iterable<X>
+			and std::is_same_v<typename T::value_type, _T>) {
+			// vectorized search of times
+			auto t_ = upto(t, ge(_t));
+			x += t_.data() - t.data();
+			t = t_;
+			if (t and x) {
+				return std::pair(*t, *x);
+			}
+
+			return std::pair(NaN<_T>(), _x);
+		}
+
 		while (t and x) {
 			if (*t >= _t) {
 				return std::pair(*t, *x);
@@ -114,7 +133,7 @@ namespace fms::pwflat {
 	// integrate x(t) from t0 to _t and advance t, x
 	template<input_iterable T, input_iterable X,
 		class _T = typename T::value_type, class _X = typename X::value_type>
-	inline _X integrate(T& t, X& x, const _T& _t, const _T& t0 = _T(0))
+	inline _X integrate(T& t, X& x, const _T& _t, _T t0 = _T(0))
 	{
 		_X I = 0;
 
@@ -144,10 +163,35 @@ namespace fms::pwflat {
 		return integrate(t_, x_, _t, t0);
 	}
 
+#ifdef _DEBUG
+	inline int test_integral()
+	{
+		{
+			const double t[] = { 1., 2., 3. };
+			const double x[] = { .1, .2, .3 };
+			auto t_ = array(t);
+			auto x_ = array(x);
+			static_assert(std::is_same_v<double, decltype(t_)::value_type>);
+
+			assert(0 == integral(t_, x_, 0.));
+			assert(fabs(integral(t_, x_, .5) - .05) < 1e-15);
+			assert(fabs(integral(t_, x_, 2.5) - .45) < 1e-15);
+			assert(fabs(integral(t_, x_, 2.5, 1.) - .35) < 1e-15);
+
+			auto t__{ t_ };
+			auto x__{ x_ };
+			assert(fabs(integrate(t__, x__, 1.5) - .2) < 1e-15);
+			assert(2 == *t__);
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
 	// pv and discount to last cash flow
 	template<input_iterable T, input_iterable X,
 		class _T = typename T::value_type, class _X = typename X::value_type>
-	std::pair<_X, _X> present_valuate(T& t, X& x, T& u, X& c, const _T& t0 = _T(0))
+	std::pair<_X, _X> present_valuate(T& t, X& x, T& u, X& c, _T t0 = _T(0))
 	{
 		_X pv = 0;
 		_X D = 1;
@@ -249,13 +293,13 @@ namespace fms::pwflat {
 		// integrate and advance to _t
 		_X integrate(const _T& _t, const _T& t0 = _T(0))
 		{
-			return integrate(t, x, t0);
+			return pwflat::integrate(t, x, _t, t0);
 		}
 
 		// integrate but don't advance
 		_X integral(const _T& _t, const _T& t0 = _T(0)) const
 		{
-			return integral(t, x, t0);
+			return pwflat::integral(t, x, _t, t0);
 		}
 
 		_X discount(const _T& _t, const _T& t0 = _T(0)) const
@@ -274,11 +318,11 @@ namespace fms::pwflat {
 		// pv and discount to last cash flow
 		std::pair<_X, _X> present_valuate(T& u, X& c, const _T& t0 = _T(0))
 		{
-			return present_valuate(t, x, u, c, t0);
+			return pwflat::present_valuate(t, x, u, c, t0);
 		}
 		std::pair<_X, _X> present_value(T& u, X& c, const _T& t0 = _T(0)) const
 		{
-			return present_value(t, x, u, c, t0);
+			return pwflat::present_value(t, x, u, c, t0);
 		}
 
 	};
@@ -323,4 +367,756 @@ namespace fms::pwflat {
 	}
 #endif // _DEBUG
 
+	// Curve over contiguous pillars with the integral of the forward
+	// curve at each pillar, I[i] = int_0^t[i] f(s) ds, so lookups are a
+	// binary search and integrals a multiply-add. Memory is not owned.
+	template<class T = double, class X = double>
+	class indexed_view {
+	protected:
+		size_t n;
+		const T* t;
+		const X* x;
+		const X* I;
+		X _x; // extrapolate
+	public:
+		// remembers the last index for nondecreasing queries
+		struct hint {
+			size_t i = 0;
+		};
+
+		indexed_view(size_t n = 0, const T* t = nullptr, const X* x = nullptr, const X* I = nullptr, const X& _x = NaN<X>())
+			: n(n), t(t), x(x), I(I), _x(_x)
+		{ }
+		indexed_view(const indexed_view&) = default;
+		indexed_view& operator=(const indexed_view&) = default;
+		~indexed_view()
+		{ }
+
+		size_t size() const
+		{
+			return n;
+		}
+		auto time() const
+		{
+			return array(n, t);
+		}
+		auto rate() const
+		{
+			return array(n, x);
+		}
+		auto integrals() const
+		{
+			return array(n, I);
+		}
+		X extrapolate() const
+		{
+			return _x;
+		}
+
+		// first i with _t <= t[i], or n
+		size_t index(const T& _t) const
+		{
+			return std::lower_bound(t, t + n, _t) - t;
+		}
+		// gallop forward from h.i so monotone queries are O(1) amortized
+		size_t index(const T& _t, hint& h) const
+		{
+			size_t lo = h.i <= n and (h.i == 0 or t[h.i - 1] < _t) ? h.i : 0;
+			size_t hi = lo;
+
+			for (size_t step = 1; hi < n and t[hi] < _t; step *= 2) {
+				lo = hi + 1;
+				hi += step;
+			}
+			h.i = std::lower_bound(t + lo, t + std::min(hi, n), _t) - t;
+
+			return h.i;
+		}
+
+		// f(_t) given i = index(_t)
+		X value_at(size_t i) const
+		{
+			return i < n ? x[i] : _x;
+		}
+		// int_0^_t f(s) ds given i = index(_t)
+		X integral_at(size_t i, const T& _t) const
+		{
+			if (i == 0) {
+				return value_at(0) * _t;
+			}
+
+			return I[i - 1] + value_at(i) * (_t - t[i - 1]);
+		}
+
+		X value(const T& _t) const
+		{
+			return value_at(index(_t));
+		}
+		X value(const T& _t, hint& h) const
+		{
+			return value_at(index(_t, h));
+		}
+		// instantaneous forward
+		X forward(const T& _t) const
+		{
+			return value(_t);
+		}
+
+		X integral(const T& _t) const
+		{
+			return integral_at(index(_t), _t);
+		}
+		X integral(const T& _t, hint& h) const
+		{
+			return integral_at(index(_t, h), _t);
+		}
+		X integral(const T& _t, const T& t0) const
+		{
+			return integral(_t) - integral(t0);
+		}
+
+		X discount(const T& _t) const
+		{
+			return exp(-integral(_t));
+		}
+		X discount(const T& _t, hint& h) const
+		{
+			return exp(-integral(_t, h));
+		}
+		X discount(const T& _t, const T& t0) const
+		{
+			return exp(-integral(_t, t0));
+		}
+
+		// t r(t) = int_0^t f(s) ds
+		X spot(const T& _t) const
+		{
+			size_t i = index(_t);
+
+			return i == 0 ? value_at(0) : integral_at(i, _t) / _t;
+		}
+		X spot(const T& _t, hint& h) const
+		{
+			size_t i = index(_t, h);
+
+			return i == 0 ? value_at(0) : integral_at(i, _t) / _t;
+		}
+
+		// simple compounded forward over [e, e + p] with day count fraction dcf
+		// (D(e)/D(e + p) - 1)/dcf
+		X forward(const T& e, const T& p, const X& dcf) const
+		{
+			return (exp(integral(e + p) - integral(e)) - 1) / dcf;
+		}
+
+		// Batch versions write f(u[k]) to out[k]. Sorted u take one pass
+		// over the pillars and exponentials are vectorized.
+		void forward(std::span<const T> u, std::span<X> out) const
+		{
+			check(u, out);
+			hint h;
+			for (size_t k = 0; k < u.size(); ++k) {
+				out[k] = value(u[k], h);
+			}
+		}
+		void integral(std::span<const T> u, std::span<X> out) const
+		{
+			check(u, out);
+			hint h;
+			for (size_t k = 0; k < u.size(); ++k) {
+				out[k] = integral(u[k], h);
+			}
+		}
+		void discount(std::span<const T> u, std::span<X> out) const
+		{
+			check(u, out);
+			hint h;
+			for (size_t k = 0; k < u.size(); ++k) {
+				out[k] = -integral(u[k], h);
+			}
+			simd::exp(out.data(), out.data(), out.size());
+		}
+		void spot(std::span<const T> u, std::span<X> out) const
+		{
+			check(u, out);
+			hint h;
+			for (size_t k = 0; k < u.size(); ++k) {
+				out[k] = spot(u[k], h);
+			}
+		}
+		// simple compounded forwards over [e[k], e[k] + p[k]]
+		void forward(std::span<const T> e, std::span<const T> p, std::span<const X> dcf, std::span<X> out) const
+		{
+			check(e, out);
+			check(p, out);
+			if (dcf.size() != out.size()) {
+				throw std::invalid_argument("fms::pwflat::indexed_view: input and output sizes differ");
+			}
+			hint he, hp; // effective and maturity usually both increase
+			for (size_t k = 0; k < e.size(); ++k) {
+				out[k] = integral(e[k] + p[k], hp) - integral(e[k], he);
+			}
+			simd::exp(out.data(), out.data(), out.size());
+			for (size_t k = 0; k < out.size(); ++k) {
+				out[k] = (out[k] - 1) / dcf[k];
+			}
+		}
+	private:
+		static void check(std::span<const T> u, std::span<X> out)
+		{
+			if (u.size() != out.size()) {
+				throw std::invalid_argument("fms::pwflat::indexed_view: input and output sizes differ");
+			}
+		}
+	};
+
+	// Indexed curve owning its pillars.
+	template<class T = double, class X = double>
+	class indexed : public indexed_view<T, X> {
+		std::vector<T> t_;
+		std::vector<X> x_;
+		std::vector<X> I_;
+
+		void bind()
+		{
+			this->n = t_.size();
+			this->t = t_.data();
+			this->x = x_.data();
+			this->I = I_.data();
+		}
+	public:
+		indexed(const X& _x = NaN<X>())
+			: indexed_view<T, X>(0, nullptr, nullptr, nullptr, _x)
+		{ }
+		// pillars from iterables
+		template<input_iterable T_, input_iterable X_>
+		indexed(T_ t, X_ x, const X& _x = NaN<X>())
+			: indexed(_x)
+		{
+			while (t and x) {
+				push_back(*t, *x);
+				++t;
+				++x;
+			}
+		}
+		indexed(const indexed& f)
+			: indexed_view<T, X>(f), t_(f.t_), x_(f.x_), I_(f.I_)
+		{
+			bind();
+		}
+		indexed(indexed&& f) noexcept
+			: indexed_view<T, X>(f), t_(std::move(f.t_)), x_(std::move(f.x_)), I_(std::move(f.I_))
+		{
+			bind();
+			f.bind();
+		}
+		indexed& operator=(indexed f)
+		{
+			std::swap(this->_x, f._x);
+			std::swap(t_, f.t_);
+			std::swap(x_, f.x_);
+			std::swap(I_, f.I_);
+			bind();
+
+			return *this;
+		}
+		~indexed()
+		{ }
+
+		const indexed_view<T, X>& view() const
+		{
+			return *this;
+		}
+
+		// add pillar after the last one
+		indexed& push_back(const T& t, const X& x)
+		{
+			if (!t_.empty() and !(t_.back() < t)) {
+				throw std::invalid_argument("fms::pwflat::indexed::push_back: times must be increasing");
+			}
+			I_.push_back(I_.empty() ? x * t : I_.back() + x * (t - t_.back()));
+			t_.push_back(t);
+			x_.push_back(x);
+			bind();
+
+			return *this;
+		}
+		// remove all pillars keeping capacity
+		indexed& clear()
+		{
+			t_.clear();
+			x_.clear();
+			I_.clear();
+			bind();
+
+			return *this;
+		}
+		void reserve(size_t n)
+		{
+			t_.reserve(n);
+			x_.reserve(n);
+			I_.reserve(n);
+			bind();
+		}
+		// remove last pillar
+		indexed& pop_back()
+		{
+			t_.pop_back();
+			x_.pop_back();
+			I_.pop_back();
+			bind();
+
+			return *this;
+		}
+		// set rate on (t[i-1], t[i]] and patch integrals from i in O(n - i)
+		// i == size() sets the extrapolation rate
+		indexed& update_pillar(size_t i, const X& x)
+		{
+			if (i > t_.size()) {
+				throw std::out_of_range("fms::pwflat::indexed::update_pillar: index out of range");
+			}
+			if (i == t_.size()) {
+				this->_x = x;
+			}
+			else {
+				// recompute rather than add the difference so repeated
+				// updates agree exactly with a curve built from scratch
+				x_[i] = x;
+				for (size_t j = i; j < I_.size(); ++j) {
+					I_[j] = j == 0 ? x_[0] * t_[0] : I_[j - 1] + x_[j] * (t_[j] - t_[j - 1]);
+				}
+			}
+
+			return *this;
+		}
+		void extrapolate(const X& _x)
+		{
+			this->_x = _x;
+		}
+		using indexed_view<T, X>::extrapolate;
+	};
+
+#ifdef _DEBUG
+	inline int test_indexed()
+	{
+		{
+			double t[] = { 1, 2, 3 };
+			double x[] = { .1, .2, .3 };
+			indexed f(array(t), array(x), .4);
+			assert(3 == f.size());
+			assert(equal(f.time(), array(t)));
+
+			// agrees with the iterable functions
+			indexed_view<>::hint h;
+			for (double _t = -1; _t <= 5; _t += 0.25) {
+				auto v = value(array(t), array(x), _t, .4);
+				assert(f.value(_t) == v.second);
+				assert(f.value(_t, h) == v.second);
+				if (_t <= 3) {
+					double I = integral(array(t), array(x), _t);
+					assert(fabs(f.integral(_t) - I) < 1e-15);
+					assert(fabs(f.integral(_t, h) - I) < 1e-15);
+					assert(fabs(f.discount(_t) - exp(-I)) < 1e-15);
+				}
+			}
+			assert(fabs(f.integral(4.) - (.6 + .4)) < 1e-15);
+			assert(fabs(f.integral(2.5, 1.) - .35) < 1e-15);
+			assert(f.spot(.5) == .1);
+			assert(fabs(f.spot(2.) - .15) < 1e-15);
+
+			// hint moving backward
+			assert(1 == f.index(1.5, h));
+			assert(0 == f.index(.5, h));
+			assert(3 == f.index(7., h));
+			assert(2 == f.index(3., h));
+
+			// batch
+			std::vector<double> u = { -1, 0, .5, 1, 1.5, 2, 2.5, 3, 3.5, 4, 10 };
+			std::vector<double> out(u.size());
+			f.discount(u, out);
+			for (size_t k = 0; k < u.size(); ++k) {
+				assert(fabs(out[k] - f.discount(u[k])) <= 1e-15 * out[k]);
+			}
+			f.forward(u, out);
+			for (size_t k = 0; k < u.size(); ++k) {
+				assert(out[k] == f.forward(u[k]));
+			}
+			f.spot(u, out);
+			for (size_t k = 0; k < u.size(); ++k) {
+				assert(out[k] == f.spot(u[k]));
+			}
+			// forward rate agreements
+			std::vector<double> e = { 0, .5, 1, 1.5, 2.5, 3.5 };
+			std::vector<double> p(e.size(), .5), dcf(e.size(), .5);
+			std::vector<double> F(e.size());
+			f.forward(e, p, dcf, F);
+			for (size_t k = 0; k < e.size(); ++k) {
+				double F_ = (f.discount(e[k]) / f.discount(e[k] + p[k]) - 1) / dcf[k];
+				assert(fabs(F[k] - F_) < 1e-14);
+				assert(fabs(F[k] - f.forward(e[k], p[k], dcf[k])) < 1e-14);
+			}
+			assert(fabs(F[1] - (exp(.05) - 1) / .5) < 1e-15);
+
+			f.integral(std::span(u).subspan(2), std::span(out).subspan(2));
+			assert(out[2] == f.integral(.5));
+			try {
+				f.spot(u, std::span(out).subspan(1));
+				assert(false);
+			}
+			catch (const std::invalid_argument&) {
+			}
+
+			indexed g{ f };
+			f.pop_back();
+			assert(2 == f.size() and 3 == g.size());
+			assert(g.value(2.5) == .3);
+			g = f;
+			assert(2 == g.size());
+			assert(std::isnan(indexed<>().discount(1.)));
+			assert(0 == indexed<>(.1).index(1.));
+			assert(fabs(indexed<>(.1).integral(2.) - .2) < 1e-15);
+
+			try {
+				g.push_back(1., 1.);
+				assert(false);
+			}
+			catch (const std::invalid_argument&) {
+			}
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+	// Reverse mode sensitivities of present values to the rates of an
+	// indexed curve. Cash flow c at u adds w = c D(u) to the value and
+	// -w times the overlap of [0, u] with each segment to the gradient,
+	// so it is enough to accumulate per segment the weights and the
+	// overlap with the segment containing u. One backward sweep over
+	// the segments gives the gradient. The curve must outlive it.
+	template<class T = double, class X = double>
+	class adjoint {
+		indexed_view<T, X> f;
+		std::vector<X> A; // sum of w in segment
+		std::vector<X> B; // sum of w (u - t[i-1]) in segment
+		X pv;
+		typename indexed_view<T, X>::hint h;
+	public:
+		adjoint(const indexed_view<T, X>& f)
+			: f(f), A(f.size() + 1, X(0)), B(f.size() + 1, X(0)), pv(0)
+		{ }
+		adjoint(const adjoint&) = default;
+		adjoint& operator=(const adjoint&) = default;
+		~adjoint()
+		{ }
+
+		const indexed_view<T, X>& curve() const
+		{
+			return f;
+		}
+
+		// value of cash flows added so far
+		X value() const
+		{
+			return pv;
+		}
+
+		// add amount c at time u and return its present value
+		X add(const T& u, const X& c)
+		{
+			size_t i = f.index(u, h);
+			X w = c * exp(-f.integral_at(i, u));
+			T t0 = i == 0 ? T(0) : f.time()[i - 1];
+
+			A[i] += w;
+			B[i] += w * (u - t0);
+			pv += w;
+
+			return w;
+		}
+		// add cash flows of an instrument and return its present value
+		template<input_iterable U, input_iterable C>
+		X add(U u, C c)
+		{
+			X pv_ = 0;
+
+			while (u and c) {
+				pv_ += add(*u, *c);
+				++u;
+				++c;
+			}
+
+			return pv_;
+		}
+
+		// d value / d x[i] for i < n and d value / d _x at n
+		void gradient(std::span<X> g) const
+		{
+			if (g.size() != A.size()) {
+				throw std::invalid_argument("fms::pwflat::adjoint::gradient: size must be curve size + 1");
+			}
+
+			const T* t = f.time().data();
+			size_t n = f.size();
+			X S = 0; // weights of later segments
+
+			g[n] = -B[n];
+			S += A[n];
+			for (size_t i = n; i-- > 0; ) {
+				T dt = t[i] - (i == 0 ? T(0) : t[i - 1]);
+				g[i] = -(B[i] + S * dt);
+				S += A[i];
+			}
+		}
+		std::vector<X> gradient() const
+		{
+			std::vector<X> g(A.size());
+			gradient(g);
+
+			return g;
+		}
+
+		void reset()
+		{
+			std::fill(A.begin(), A.end(), X(0));
+			std::fill(B.begin(), B.end(), X(0));
+			pv = 0;
+			h = {};
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_adjoint()
+	{
+		double t[] = { 1, 2, 3 };
+		double x[] = { .01, .02, .03 };
+		double _x = .04;
+		double u[] = { .5, 1, 1.5, 2.5, 3, 4 };
+		double c[] = { 1, 2, 3, 4, 5, 6 };
+		indexed f(array(t), array(x), _x);
+
+		adjoint a(f);
+		double pv = a.add(array(u), array(c));
+		assert(pv == a.value());
+		double pv_ = 0;
+		for (size_t k = 0; k < 6; ++k) {
+			pv_ += c[k] * f.discount(u[k]);
+		}
+		assert(fabs(pv - pv_) < 1e-14);
+
+		// central differences
+		auto g = a.gradient();
+		assert(4 == g.size());
+		double eps = 1e-6;
+		for (size_t i = 0; i <= 3; ++i) {
+			double xp[] = { x[0], x[1], x[2], _x };
+			double xm[] = { x[0], x[1], x[2], _x };
+			xp[i] += eps;
+			xm[i] -= eps;
+			indexed fp(array(t), take(3, ptr(xp)), xp[3]);
+			indexed fm(array(t), take(3, ptr(xm)), xm[3]);
+			adjoint ap(fp), am(fm);
+			double dpv = (ap.add(array(u), array(c)) - am.add(array(u), array(c))) / (2 * eps);
+			assert(fabs(g[i] - dpv) < 1e-8);
+		}
+
+		a.reset();
+		assert(0 == a.value());
+		a.add(1.5, 1.);
+		g = a.gradient();
+		assert(fabs(g[0] + f.discount(1.5)) < 1e-15);
+		assert(fabs(g[1] + .5 * f.discount(1.5)) < 1e-15);
+		assert(0 == g[2] and 0 == g[3]);
+
+		return 0;
+	}
+#endif // _DEBUG
+
+	// exp usable in constant expressions
+	template<class X>
+	inline constexpr X constexpr_exp(X x)
+	{
+		if (!std::is_constant_evaluated()) {
+			return ::exp(x);
+		}
+		if (x != x) {
+			return x;
+		}
+		if (x > X(709.8)) {
+			return std::numeric_limits<X>::infinity();
+		}
+		if (x < X(-745.2)) {
+			return X(0);
+		}
+
+		// x = k log(2) + r, |r| <= log(2)/2
+		constexpr X ln2 = X(0.6931471805599453);
+		constexpr X ln2_hi = X(6.93145751953125e-1), ln2_lo = X(1.42860682030941723212e-6);
+		long k = static_cast<long>(x / ln2 + (x < 0 ? X(-0.5) : X(0.5)));
+		X r = (x - k * ln2_hi) - k * ln2_lo;
+		X e = 1, term = 1;
+		for (int j = 1; j < 24; ++j) {
+			term *= r / j;
+			e += term;
+		}
+		for (; k > 0; --k) {
+			e *= 2;
+		}
+		for (; k < 0; ++k) {
+			e /= 2;
+		}
+
+		return e;
+	}
+
+	// Curve with N pillars known at compile time. Segment lookup is a
+	// binary search with a fixed number of steps and no data dependent
+	// branches.
+	template<size_t N, class T = double, class X = double>
+	class static_curve {
+		std::array<T, N> t;
+		std::array<T, N + 1> t0; // start of segment, 0 for first
+		std::array<X, N + 1> x;  // rate on segment, _x after last pillar
+		std::array<X, N + 1> I;  // integral to start of segment
+	public:
+		constexpr static_curve(const std::array<T, N>& t, const std::array<X, N>& x_, const X& _x = NaN<X>())
+			: t(t), t0{}, x{}, I{}
+		{
+			for (size_t i = 0; i < N; ++i) {
+				x[i] = x_[i];
+				t0[i + 1] = t[i];
+				I[i + 1] = I[i] + x[i] * (t0[i + 1] - t0[i]);
+			}
+			x[N] = _x;
+		}
+		constexpr static_curve(const T(&t)[N], const X(&x)[N], const X& _x = NaN<X>())
+			: static_curve(std::to_array(t), std::to_array(x), _x)
+		{ }
+
+		static constexpr size_t size()
+		{
+			return N;
+		}
+
+		// first i with _t <= t[i], or N
+		constexpr size_t index(const T& _t) const
+		{
+			size_t i = 0;
+
+			// log2(N) steps compiled to conditional moves
+			for (size_t step = std::bit_floor(N); step; step /= 2) {
+				i = i + step <= N and t[i + step - 1] < _t ? i + step : i;
+			}
+
+			return i;
+		}
+
+		constexpr X value(const T& _t) const
+		{
+			return x[index(_t)];
+		}
+		constexpr X integral(const T& _t) const
+		{
+			size_t i = index(_t);
+
+			return I[i] + x[i] * (_t - t0[i]);
+		}
+		constexpr X integral(const T& _t, const T& _t0) const
+		{
+			return integral(_t) - integral(_t0);
+		}
+		constexpr X discount(const T& _t) const
+		{
+			return constexpr_exp(-integral(_t));
+		}
+		constexpr X discount(const T& _t, const T& _t0) const
+		{
+			return constexpr_exp(-integral(_t, _t0));
+		}
+		constexpr X spot(const T& _t) const
+		{
+			size_t i = index(_t);
+
+			return i == 0 ? x[0] : (I[i] + x[i] * (_t - t0[i])) / _t;
+		}
+
+		// sum of c D(u) for cash flows at u >= 0
+		template<input_iterable U, input_iterable C>
+		constexpr X present_value(U u, C c) const
+		{
+			X pv = 0;
+
+			while (u and c) {
+				if (*u >= 0) {
+					pv += *c * discount(*u);
+				}
+				++u;
+				++c;
+			}
+
+			return pv;
+		}
+		template<size_t M>
+		constexpr X present_value(const std::array<T, M>& u, const std::array<X, M>& c) const
+		{
+			X pv = 0;
+
+			for (size_t k = 0; k < M; ++k) {
+				if (u[k] >= 0) {
+					pv += c[k] * discount(u[k]);
+				}
+			}
+
+			return pv;
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_static_curve()
+	{
+		constexpr static_curve<3> f({ 1., 2., 3. }, { .01, .02, .03 }, .04);
+		static_assert(3 == f.size());
+		static_assert(0 == f.index(-1.) and 0 == f.index(1.) and 1 == f.index(1.5) and 3 == f.index(4.));
+		static_assert(.01 == f.value(.5));
+		static_assert(.02 == f.value(2.));
+		static_assert(.04 == f.value(9.));
+		static_assert(f.integral(4.) > .1 - 1e-15 and f.integral(4.) < .1 + 1e-15);
+		static_assert(f.discount(0.) == 1);
+		constexpr double D2 = f.discount(2.);
+		static_assert(D2 < 1 and D2 > .97);
+		constexpr double pv = f.present_value(std::array{ 1., 2. }, std::array{ .05, 1.05 });
+		static_assert(pv > 1 and pv < 1.1);
+
+		// compile time agrees with run time
+		constexpr std::array x_ = { -800., -700., -10., -1., -1e-9, 0., 1e-9, .3, 1., 5., 700., 800. };
+		constexpr auto e_ = [&x_]() {
+			std::array<double, x_.size()> e{};
+			for (size_t i = 0; i < x_.size(); ++i) {
+				e[i] = constexpr_exp(x_[i]);
+			}
+			return e;
+		}();
+		for (size_t i = 0; i < x_.size(); ++i) {
+			double e = ::exp(x_[i]);
+			assert(e_[i] == e or fabs(e_[i] - e) <= 4 * std::numeric_limits<double>::epsilon() * e);
+		}
+		assert(fabs(D2 - ::exp(-.03)) <= 1e-15);
+		double t[] = { 1, 2, 3 };
+		double x[] = { .01, .02, .03 };
+		static_curve g(t, x, .04);
+		indexed h(array(t), array(x), .04);
+		for (double _t = -1; _t < 5; _t += .125) {
+			assert(g.value(_t) == h.value(_t));
+			assert(fabs(g.integral(_t) - h.integral(_t)) < 1e-15);
+			assert(fabs(g.discount(_t) - h.discount(_t)) < 1e-15);
+			assert(fabs(g.spot(_t) - h.spot(_t)) < 1e-15);
+		}
+		double u[] = { .5, 1.5, 4 };
+		double c[] = { 1, 1, 1 };
+		assert(fabs(g.present_value(array(u), array(c)) - (h.discount(.5) + h.discount(1.5) + h.discount(4.))) < 1e-15);
+
+		return 0;
+	}
+#endif // _DEBUG
+
 } // namespace fms
@@ -0,0 +1,341 @@
+// fms_ranges.h - adapt iterables to and from std::ranges
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#include <list>
+#include <numeric>
+#include <vector>
+#endif
+#include <iterator>
+#include <ranges>
+#include "fms_iterable.h"
+
+namespace fms::iterable {
+
+	// Iterable as a std::ranges::view. Sized contiguous iterables iterate
+	// over pointers so they can be passed to vectorized and parallel
+	// algorithms, sized random access iterables are random access ranges
+	// and all others are input ranges ending at std::default_sentinel.
+	template<input_iterable I>
+	class view : public std::ranges::view_interface<view<I>> {
+		I i;
+	public:
+		// offset into the view's iterable
+		class index_iterator {
+			const I* i;
+			ptrdiff_t k;
+		public:
+			using iterator_concept = std::random_access_iterator_tag;
+			using iterator_category = std::input_iterator_tag; // items are computed
+			using value_type = typename I::value_type;
+			using difference_type = ptrdiff_t;
+
+			index_iterator(const I* i = nullptr, ptrdiff_t k = 0)
+				: i(i), k(k)
+			{ }
+
+			bool operator==(const index_iterator& j) const
+			{
+				return k == j.k;
+			}
+			auto operator<=>(const index_iterator& j) const
+			{
+				return k <=> j.k;
+			}
+
+			value_type operator*() const
+			{
+				return (*i)[k];
+			}
+			value_type operator[](ptrdiff_t n) const
+			{
+				return (*i)[k + n];
+			}
+			index_iterator& operator++()
+			{
+				++k;
+
+				return *this;
+			}
+			index_iterator operator++(int)
+			{
+				return index_iterator(i, k++);
+			}
+			index_iterator& operator--()
+			{
+				--k;
+
+				return *this;
+			}
+			index_iterator operator--(int)
+			{
+				return index_iterator(i, k--);
+			}
+			index_iterator& operator+=(ptrdiff_t n)
+			{
+				k += n;
+
+				return *this;
+			}
+			index_iterator& operator-=(ptrdiff_t n)
+			{
+				k -= n;
+
+				return *this;
+			}
+			friend index_iterator operator+(index_iterator j, ptrdiff_t n)
+			{
+				return j += n;
+			}
+			friend index_iterator operator+(ptrdiff_t n, index_iterator j)
+			{
+				return j += n;
+			}
+			friend index_iterator operator-(index_iterator j, ptrdiff_t n)
+			{
+				return j -= n;
+			}
+			friend ptrdiff_t operator-(const index_iterator& a, const index_iterator& b)
+			{
+				return a.k - b.k;
+			}
+		};
+
+		// advance a copy of the iterable
+		class input_iterator {
+			I i;
+		public:
+			using iterator_concept = std::input_iterator_tag;
+			using value_type = typename I::value_type;
+			using difference_type = ptrdiff_t;
+
+			input_iterator(const I& i)
+				: i(i)
+			{ }
+
+			bool operator==(std::default_sentinel_t) const
+			{
+				return !i;
+			}
+
+			value_type operator*() const
+			{
+				return *i;
+			}
+			input_iterator& operator++()
+			{
+				++i;
+
+				return *this;
+			}
+			void operator++(int)
+			{
+				++i;
+			}
+		};
+
+		view()
+			requires std::default_initializable<I> = default;
+		explicit view(const I& i)
+			: i(i)
+		{ }
+
+		auto begin() const
+		{
+			if constexpr (contiguous_iterable<I> and sized_iterable<I>) {
+				return i.data();
+			}
+			else if constexpr (random_access_iterable<I> and sized_iterable<I>) {
+				return index_iterator(&i, 0);
+			}
+			else {
+				return input_iterator(i);
+			}
+		}
+		auto end() const
+		{
+			if constexpr (contiguous_iterable<I> and sized_iterable<I>) {
+				return i.data() + i.size();
+			}
+			else if constexpr (random_access_iterable<I> and sized_iterable<I>) {
+				return index_iterator(&i, static_cast<ptrdiff_t>(i.size()));
+			}
+			else {
+				return std::default_sentinel;
+			}
+		}
+	};
+
+	// Iterable from a std::ranges::range keeping its iterator strength.
+	template<std::ranges::range R>
+	class range {
+		using iterator = std::ranges::iterator_t<R>;
+		using sentinel = std::ranges::sentinel_t<R>;
+		static constexpr bool sized = std::sized_sentinel_for<sentinel, iterator>;
+		static constexpr bool random = std::random_access_iterator<iterator> and sized;
+		static constexpr bool contiguous = std::contiguous_iterator<iterator> and sized;
+
+		iterator b;
+		sentinel e;
+
+		range(const iterator& b, const sentinel& e)
+			: b(b), e(e)
+		{ }
+	public:
+		using iterator_category = std::conditional_t<contiguous, std::contiguous_iterator_tag,
+			std::conditional_t<random, std::random_access_iterator_tag, std::input_iterator_tag>>;
+		using difference_type = std::ranges::range_difference_t<R>;
+		using value_type = std::ranges::range_value_t<R>;
+		using reference = std::ranges::range_reference_t<R>;
+		using pointer = std::add_pointer_t<reference>;
+
+		// user responsible for range lifetime
+		range(R& r)
+			: b(std::ranges::begin(r)), e(std::ranges::end(r))
+		{ }
+		range(const range&) = default;
+		range& operator=(const range&) = default;
+		~range()
+		{ }
+
+		bool operator==(const range& r) const
+		{
+			return b == r.b;
+		}
+
+		range begin() const
+		{
+			return *this;
+		}
+		range end() const
+		{
+			return range(std::ranges::next(b, e), e);
+		}
+
+		explicit operator bool() const
+		{
+			return b != e;
+		}
+		value_type operator*() const
+		{
+			return *b;
+		}
+		reference operator*()
+		{
+			return *b;
+		}
+		range& operator++()
+		{
+			if (operator bool()) {
+				++b;
+			}
+
+			return *this;
+		}
+		range operator++(int)
+		{
+			auto r_{ *this };
+			operator++();
+
+			return r_;
+		}
+
+		size_t size() const
+			requires sized
+		{
+			return static_cast<size_t>(e - b);
+		}
+		value_type operator[](difference_type n) const
+			requires random
+		{
+			return b[n];
+		}
+		range& operator+=(difference_type n)
+			requires random
+		{
+			b += std::min<difference_type>(n, e - b);
+
+			return *this;
+		}
+		pointer data() const
+			requires contiguous
+		{
+			return std::to_address(b);
+		}
+		std::pair<range, range> split(size_t h) const
+			requires random and std::same_as<iterator, sentinel>
+		{
+			auto m = b + std::min<difference_type>(h, e - b);
+
+			return std::pair(range(b, m), range(m, e));
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_ranges()
+	{
+		{
+			double x[] = { 3, 1, 2 };
+			auto v = view(array(x));
+			static_assert(std::ranges::contiguous_range<decltype(v)>);
+			static_assert(std::ranges::sized_range<decltype(v)>);
+			static_assert(std::ranges::view<decltype(v)>);
+			std::ranges::sort(v);
+			assert(1 == x[0] and 2 == x[1] and 3 == x[2]);
+			assert(6 == std::reduce(v.begin(), v.end()));
+			assert(3 == v.size());
+		}
+		{
+			int x[] = { 1, 2, 3 };
+			auto v = view(apply([](int i) { return i * i; }, array(x)));
+			static_assert(std::ranges::random_access_range<decltype(v)>);
+			static_assert(std::ranges::sized_range<decltype(v)>);
+			assert(9 == v[2]);
+			assert(9 == *std::ranges::max_element(v));
+			std::vector<int> w;
+			std::ranges::copy(v | std::views::reverse, std::back_inserter(w));
+			assert((w == std::vector<int>{ 9, 4, 1 }));
+		}
+		{
+			auto v = view(take(4, when(sequence<int>(), [](auto i) { return *i % 2; })));
+			static_assert(std::ranges::input_range<decltype(v)>);
+			std::vector<int> w;
+			std::ranges::copy(v, std::back_inserter(w));
+			assert((w == std::vector<int>{ 1, 3, 5, 7 }));
+		}
+		{
+			std::vector<int> v = { 1, 2, 3 };
+			auto r = range(v);
+			static_assert(contiguous_iterable<decltype(r)>);
+			static_assert(splittable<decltype(r)>);
+			assert(3 == length(r));
+			assert(r.data() == v.data());
+			assert(equal(r, take(3, sequence<int>(1))));
+			assert(!drop(3, r));
+			assert(r.end() == drop(3, r));
+		}
+		{
+			std::list<int> l = { 1, 2, 3 };
+			auto r = range(l);
+			static_assert(input_iterable<decltype(r)>);
+			static_assert(!random_access_iterable<decltype(r)>);
+			assert(3 == length(r));
+			assert(3 == *back(r));
+		}
+		{
+			auto i = std::views::iota(0, 5);
+			auto r = range(i);
+			static_assert(random_access_iterable<decltype(r)>);
+			static_assert(!contiguous_iterable<decltype(r)>);
+			assert(5 == length(r));
+			assert(3 == r[3]);
+			// round trip
+			auto v = view(r);
+			assert(10 == std::reduce(v.begin(), v.end()));
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
@@ -0,0 +1,140 @@
+// fms_reduce.h - reduce iterables sequentially or in parallel
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "fms_iterable.h"
+#include "fms_parallel.h"
+
+namespace fms::iterable {
+
+	// items per block of a parallel reduction
+	inline constexpr size_t reduce_block = 1 << 12;
+
+	// t f i0 f i1 f ... in order
+	template<class F, input_iterable I, class T>
+	inline constexpr T accumulate(F f, I i, T t)
+	{
+		while (i) {
+			t = f(t, *i);
+			++i;
+		}
+
+		return t;
+	}
+
+	// Reduce blocks of reduce_block items on pool p, or this thread if
+	// null, and combine block results pairwise. The blocks do not depend
+	// on the number of threads so neither does the result.
+	template<class F, class I, class T>
+		requires random_access_iterable<I> and sized_iterable<I>
+	inline T reduce_blocked(F f, I i, T t, parallel::pool* p)
+	{
+		const size_t n = i.size();
+		const size_t nb = (n + reduce_block - 1) / reduce_block;
+
+		if (nb < 2) {
+			return accumulate(f, i, t);
+		}
+
+		std::vector<T> b(nb, t);
+		auto block = [&](size_t k) {
+			size_t m = std::min(reduce_block, n - k * reduce_block);
+			auto j = drop(k * reduce_block, i);
+			T s = *j;
+			for (size_t l = 1; l < m; ++l) {
+				s = f(s, j[l]);
+			}
+			b[k] = s;
+		};
+
+		if (p) {
+			parallel::for_each(take(nb, sequence<size_t>()), block, 1, *p);
+		}
+		else {
+			for (size_t k = 0; k < nb; ++k) {
+				block(k);
+			}
+		}
+
+		for (size_t m = nb; m > 1; m = (m + 1) / 2) {
+			for (size_t k = 0; 2 * k + 1 < m; ++k) {
+				b[k] = f(b[2 * k], b[2 * k + 1]);
+			}
+			if (m % 2) {
+				b[m / 2] = b[m - 1];
+			}
+		}
+
+		return f(t, b[0]);
+	}
+
+	// Reduce using associative f. Sized random access iterables
+	// are reduced in parallel on pool p, or this thread if null.
+	template<class F, input_iterable I, class T>
+	inline T reduce(F f, I i, T t, parallel::pool* p = &parallel::pool::instance())
+	{
+		if constexpr (random_access_iterable<I> and sized_iterable<I>) {
+			return reduce_blocked(f, i, t, p);
+		}
+		else {
+			return accumulate(f, i, t);
+		}
+	}
+
+	// reduce f over g(i0), g(i1), ...
+	template<class F, class G, input_iterable I, class T>
+	inline T transform_reduce(F f, G g, I i, T t, parallel::pool* p = &parallel::pool::instance())
+	{
+		return reduce(f, apply(g, i), t, p);
+	}
+
+	template<input_iterable I, class T = typename I::value_type>
+	inline T sum(I i, parallel::pool* p = &parallel::pool::instance())
+	{
+		return reduce(std::plus<T>{}, i, T(0), p);
+	}
+
+#ifdef _DEBUG
+	inline int test_reduce()
+	{
+		{
+			int i[] = { 1,2,3 };
+			assert(6 == sum(array(i)));
+			assert(6 == reduce(std::multiplies<int>{}, array(i), 1));
+			assert(14 == transform_reduce(std::plus<int>{}, [](int i) { return i * i; }, array(i), 0));
+			assert(0 == sum(array<int>()));
+			// input iterables are accumulated in order
+			assert(6 == sum(take(3, when(sequence<int>(1), [](auto) { return true; }))));
+		}
+		{
+			std::vector<double> x(10 * reduce_block + 17);
+			for (size_t k = 0; k < x.size(); ++k) {
+				x[k] = 1. / (1 + k);
+			}
+			auto c = container(x);
+			double s1 = sum(c, nullptr);
+			parallel::pool p2(2), p3(3);
+			assert(s1 == sum(c, &p2));
+			assert(s1 == sum(c, &p3));
+			assert(s1 == sum(c));
+			assert(fabs(s1 - accumulate(std::plus<double>{}, c, 0.)) < 1e-12);
+		}
+		{
+			std::vector<long long> x(3 * reduce_block + 1);
+			for (size_t k = 0; k < x.size(); ++k) {
+				x[k] = k;
+			}
+			long long n = x.size();
+			assert(n * (n - 1) / 2 == sum(container(x)));
+			assert(n * (n - 1) / 2 == *back(fold(std::plus<long long>{}, container(x), 0LL)));
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
@@ -6,6 +6,8 @@
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <stdexcept>
+#include <utility>
 #include "fms_iterable.h"
 
 namespace fms::root1d {
@@ -38,6 +40,83 @@ namespace fms::root1d {
 		return upto(i, p);
 	}
 
+	// Newton's method safeguarded by bisection on a bracket [a, b] with f(a) f(b) <= 0.
+	// df(x) returns the pair f(x), f'(x). Stop when |f(x)| <= tol.
+	// Return the root and the number of iterations.
+	template<class X, class DF>
+	inline std::pair<X, size_t> newton_bracket(const DF& df, X a, X b, X x,
+		const X& tol = 8 * epsilon<X>(), size_t max = 100)
+	{
+		X fa = df(a).first;
+		X fb = df(b).first;
+
+		if (fa == 0) {
+			return std::pair(a, size_t(0));
+		}
+		if (fb == 0) {
+			return std::pair(b, size_t(0));
+		}
+		if ((fa < 0) == (fb < 0)) {
+			throw std::runtime_error("fms::root1d::newton_bracket: root not bracketed");
+		}
+		if (!(a < x and x < b)) {
+			x = (a + b) / 2;
+		}
+
+		for (size_t n = 1; n <= max; ++n) {
+			auto [y, dy] = df(x);
+			if (std::fabs(y) <= tol) {
+				return std::pair(x, n);
+			}
+			if ((y < 0) == (fa < 0)) {
+				a = x;
+				fa = y;
+			}
+			else {
+				b = x;
+			}
+			X x_ = x - y / dy;
+			if (!(a < x_ and x_ < b)) {
+				x_ = (a + b) / 2; // bisect
+			}
+			if (x_ == x) {
+				return std::pair(x, n);
+			}
+			x = x_;
+		}
+
+		throw std::runtime_error("fms::root1d::newton_bracket: too many iterations");
+	}
+
+#ifdef _DEBUG
+	inline int test_newton_bracket()
+	{
+		{
+			auto f = [](double x) { return std::pair(x * x - 2, 2 * x); };
+			auto [x, n] = newton_bracket(f, 0., 2., 1.);
+			assert(nearly_equal(x, sqrt(2.)));
+			assert(n < 10);
+		}
+		{
+			// Newton from 0 overshoots, bisection keeps it in the bracket
+			auto f = [](double x) { return std::pair(atan(x - 1), 1 / (1 + (x - 1) * (x - 1))); };
+			auto [x, n] = newton_bracket(f, -10., 20., -9.);
+			assert(fabs(x - 1) < 1e-15);
+		}
+		{
+			auto f = [](double x) { return std::pair(x * x + 1, 2 * x); };
+			try {
+				newton_bracket(f, -1., 1., 0.);
+				assert(false);
+			}
+			catch (const std::runtime_error&) {
+			}
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
 	template<class X, class Y>
 	struct secant {
 		const std::function<Y(X)>& f;
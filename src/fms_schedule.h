@@ -0,0 +1,280 @@
+// fms_schedule.h - payment schedules generated once and shared
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "fms_iterable.h"
+
+namespace fms::schedule {
+
+	using std::chrono::year_month_day;
+	using std::chrono::sys_days;
+	using std::chrono::months;
+
+	// how payment dates are generated from effective and maturity
+	enum class roll {
+		forward,      // effective + k period, short stub at maturity
+		backward,     // maturity - k period, short stub at effective
+		end_of_month, // last day of the months of forward
+		imm,          // third Wednesday of the months of forward
+	};
+
+	enum class day_count {
+		act_360,
+		act_365,
+		thirty_360, // ISDA bond basis
+	};
+
+	// accrual fraction from d0 to d1
+	inline double year_fraction(const year_month_day& d0, const year_month_day& d1, day_count dc)
+	{
+		double days = (sys_days(d1) - sys_days(d0)).count();
+
+		switch (dc) {
+		case day_count::act_360:
+			return days / 360;
+		case day_count::act_365:
+			return days / 365;
+		case day_count::thirty_360: {
+			int y0 = int(d0.year()), y1 = int(d1.year());
+			int m0 = int(unsigned(d0.month())), m1 = int(unsigned(d1.month()));
+			int e0 = std::min(int(unsigned(d0.day())), 30);
+			int e1 = int(unsigned(d1.day()));
+			if (e0 == 30) {
+				e1 = std::min(e1, 30);
+			}
+			return (360 * (y1 - y0) + 30 * (m1 - m0) + (e1 - e0)) / 360.;
+		}
+		}
+
+		throw std::invalid_argument("fms::schedule::year_fraction: unknown day count");
+	}
+
+	// identifies a schedule
+	struct key {
+		year_month_day effective, maturity;
+		months period;
+		roll r;
+		day_count dc;
+
+		bool operator==(const key&) const = default;
+	};
+	struct hash {
+		size_t operator()(const key& k) const
+		{
+			size_t h = std::hash<long>{}(sys_days(k.effective).time_since_epoch().count());
+			for (long x : { long(sys_days(k.maturity).time_since_epoch().count()), long(k.period.count()), long(k.r), long(k.dc) }) {
+				h = (h ^ std::hash<long>{}(x)) * 0x9e3779b97f4a7c15ull;
+			}
+
+			return h;
+		}
+	};
+
+	// Payment dates with times in years Act/365 from the valuation date
+	// and the accrual fraction of the period ending at each payment.
+	// Arrays are contiguous and can be passed to bootstrap::instrument::swap.
+	template<class T = double, class X = double>
+	struct schedule {
+		T effective;
+		std::vector<year_month_day> date;
+		std::vector<T> u;
+		std::vector<X> dcf;
+
+		size_t size() const
+		{
+			return u.size();
+		}
+	};
+
+	// payment dates of k after effective
+	inline std::vector<year_month_day> dates(const key& k)
+	{
+		if (k.period <= months{ 0 }) {
+			throw std::invalid_argument("fms::schedule::dates: period must be positive");
+		}
+		if (!(sys_days(k.effective) < sys_days(k.maturity))) {
+			throw std::invalid_argument("fms::schedule::dates: maturity must be after effective");
+		}
+
+		using std::chrono::last;
+		std::vector<year_month_day> d;
+		auto valid = [](const year_month_day& ymd) {
+			return ymd.ok() ? ymd : ymd.year() / ymd.month() / last;
+		};
+
+		if (k.r == roll::backward) {
+			// days past the end of a month are kept until clamped
+			for (auto s = iterable::sequence<year_month_day, months>(k.maturity, -k.period); ; ++s) {
+				auto ymd = valid(*s);
+				if (!(sys_days(k.effective) < sys_days(ymd))) {
+					break;
+				}
+				d.push_back(ymd);
+			}
+			std::reverse(d.begin(), d.end());
+		}
+		else {
+			auto s = iterable::sequence<year_month_day, months>(k.effective, k.period);
+			for (++s; ; ++s) {
+				auto ymd = valid(*s);
+				if (k.r == roll::end_of_month) {
+					ymd = ymd.year() / ymd.month() / last;
+				}
+				else if (k.r == roll::imm) {
+					using namespace std::chrono;
+					ymd = year_month_day(sys_days(ymd.year() / ymd.month() / Wednesday[3]));
+				}
+				if (!(sys_days(ymd) < sys_days(k.maturity))) {
+					break;
+				}
+				d.push_back(ymd);
+			}
+			d.push_back(k.maturity);
+		}
+
+		return d;
+	}
+
+	// generate schedule of k with times from valuation date v
+	template<class T = double, class X = double>
+	inline schedule<T, X> generate(const key& k, const year_month_day& v)
+	{
+		auto time = [&v](const year_month_day& d) {
+			return T((sys_days(d) - sys_days(v)).count()) / 365;
+		};
+		schedule<T, X> s{ time(k.effective), dates(k), {}, {} };
+
+		s.u.reserve(s.date.size());
+		s.dcf.reserve(s.date.size());
+		year_month_day d0 = k.effective;
+		for (const auto& d : s.date) {
+			s.u.push_back(time(d));
+			s.dcf.push_back(X(year_fraction(d0, d, k.dc)));
+			d0 = d;
+		}
+
+		return s;
+	}
+
+	// Schedules interned by key so identical schedules are generated
+	// once and shared by every trade using them. Lookups take a shared
+	// lock and only misses take the exclusive lock.
+	template<class T = double, class X = double>
+	class table {
+		year_month_day v; // valuation date
+		mutable std::shared_mutex m;
+		std::unordered_map<key, std::shared_ptr<const schedule<T, X>>, hash> s;
+	public:
+		table(const year_month_day& v)
+			: v(v)
+		{ }
+		table(const table&) = delete;
+		table& operator=(const table&) = delete;
+		~table()
+		{ }
+
+		const year_month_day& valuation() const
+		{
+			return v;
+		}
+		// number of distinct schedules
+		size_t size() const
+		{
+			std::shared_lock lock(m);
+
+			return s.size();
+		}
+
+		// schedule of k, generated on first use
+		std::shared_ptr<const schedule<T, X>> operator()(const key& k)
+		{
+			{
+				std::shared_lock lock(m);
+				auto i = s.find(k);
+				if (i != s.end()) {
+					return i->second;
+				}
+			}
+
+			auto p = std::make_shared<const schedule<T, X>>(generate<T, X>(k, v));
+			std::unique_lock lock(m);
+
+			return s.try_emplace(k, std::move(p)).first->second;
+		}
+		std::shared_ptr<const schedule<T, X>> operator()(const year_month_day& effective, const year_month_day& maturity,
+			months period, roll r = roll::backward, day_count dc = day_count::act_360)
+		{
+			return operator()(key{ effective, maturity, period, r, dc });
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_schedule()
+	{
+		using std::chrono::year;
+		using std::chrono::March;
+		using std::chrono::June;
+		constexpr year_month_day e = year{ 2024 } / 1 / 31;
+		constexpr year_month_day m = year{ 2025 } / 1 / 31;
+		{
+			// month ends clamp without drifting
+			auto d = dates(key{ e, m, months{ 1 }, roll::forward, day_count::act_360 });
+			assert(12 == d.size());
+			assert(d[0] == year{ 2024 } / 2 / 29);
+			assert(d[1] == year{ 2024 } / 3 / 31);
+			assert(d[11] == m);
+		}
+		{
+			// short stub at the front
+			auto d = dates(key{ year{ 2024 } / 2 / 15, m, months{ 3 }, roll::backward, day_count::act_360 });
+			assert(4 == d.size());
+			assert(d[0] == year{ 2024 } / 4 / 30);
+			assert(d[3] == m);
+		}
+		{
+			auto d = dates(key{ year{ 2024 } / 1 / 15, year{ 2024 } / 12 / 31, months{ 3 }, roll::end_of_month, day_count::act_360 });
+			assert(d[0] == year{ 2024 } / 4 / 30 and d[1] == year{ 2024 } / 7 / 31 and d.back() == year{ 2024 } / 12 / 31);
+		}
+		{
+			auto d = dates(key{ year{ 2024 } / March / 20, year{ 2025 } / March / 19, months{ 3 }, roll::imm, day_count::act_360 });
+			assert(d[0] == year{ 2024 } / June / 19);
+			assert(d.back() == year{ 2025 } / March / 19);
+		}
+		{
+			assert(year_fraction(year{ 2024 } / 1 / 31, year{ 2024 } / 3 / 31, day_count::thirty_360) == 60 / 360.);
+			assert(year_fraction(year{ 2024 } / 1 / 1, year{ 2025 } / 1 / 1, day_count::act_365) == 366 / 365.);
+		}
+		{
+			table<> t(year{ 2024 } / 1 / 29);
+			auto s = t(e, m, months{ 6 });
+			assert(t(e, m, months{ 6 }) == s);
+			assert(1 == t.size());
+			assert(t(e, m, months{ 3 }) != s);
+			assert(2 == t.size());
+			assert(2 == s->size());
+			assert(s->effective == 2 / 365.);
+			assert(s->u.back() == (sys_days(m) - sys_days(year{ 2024 } / 1 / 29)).count() / 365.);
+			assert(s->dcf[0] == (sys_days(year{ 2024 } / 7 / 31) - sys_days(e)).count() / 360.);
+		}
+		try {
+			dates(key{ m, e, months{ 1 }, roll::forward, day_count::act_360 });
+			assert(false);
+		}
+		catch (const std::invalid_argument&) {
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
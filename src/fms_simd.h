@@ -0,0 +1,468 @@
+// fms_simd.h - vectorized search over contiguous arithmetic data
+#pragma once
+#ifdef _DEBUG
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+#endif
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) // sse2 is baseline
+#define FMS_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FMS_TARGET_AVX2
+#else
+#define FMS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define FMS_SIMD_X86 0
+#endif
+
+namespace fms::simd {
+
+	// instruction set used by kernels
+	enum class level {
+		scalar,
+		sse2,
+		avx2,
+	};
+
+	// best level supported by this cpu
+	inline level detect()
+	{
+#if FMS_SIMD_X86
+#ifdef _MSC_VER
+		int r[4];
+		__cpuid(r, 0);
+		if (r[0] >= 7) {
+			__cpuidex(r, 7, 0);
+			if (r[1] & (1 << 5)) { // ebx
+				__cpuid(r, 1);
+				bool osxsave = r[2] & (1 << 27);
+				if (osxsave and (_xgetbv(0) & 6) == 6) {
+					return level::avx2;
+				}
+			}
+		}
+		return level::sse2;
+#else
+		return __builtin_cpu_supports("avx2") ? level::avx2 : level::sse2;
+#endif
+#else
+		return level::scalar;
+#endif
+	}
+	// detected once
+	inline level best()
+	{
+		static const level l = detect();
+
+		return l;
+	}
+
+	// item comparisons against a value, nan ignores the value
+	enum class cmp {
+		lt,
+		le,
+		gt,
+		ge,
+		eq,
+		ne,
+		nan,
+	};
+
+	// a C x, ne and nan are true for NaN
+	template<cmp C, class T>
+	inline constexpr bool test(const T& a, const T& x)
+	{
+		if constexpr (C == cmp::lt) return a < x;
+		else if constexpr (C == cmp::le) return a <= x;
+		else if constexpr (C == cmp::gt) return a > x;
+		else if constexpr (C == cmp::ge) return a >= x;
+		else if constexpr (C == cmp::eq) return a == x;
+		else if constexpr (C == cmp::ne) return a != x;
+		else return a != a;
+	}
+
+	template<cmp C, class T>
+	inline size_t find_scalar(const T* p, size_t n, const T& x)
+	{
+		for (size_t i = 0; i < n; ++i) {
+			if (test<C>(p[i], x)) {
+				return i;
+			}
+		}
+
+		return n;
+	}
+
+	template<class T>
+	inline size_t mismatch_scalar(const T* p, const T* q, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i) {
+			if (p[i] != q[i]) {
+				return i;
+			}
+		}
+
+		return n;
+	}
+
+	// exp(x) = 2^k exp(r), |r| <= log(2)/2, on [exp_lo, exp_hi]
+	inline constexpr double exp_lo = -708;
+	inline constexpr double exp_hi = 709;
+	inline constexpr double exp_log2e = 1.4426950408889634;
+	inline constexpr double exp_ln2_hi = 6.93145751953125e-1;
+	inline constexpr double exp_ln2_lo = 1.42860682030941723212e-6;
+	inline constexpr double exp_shift = 0x1.8p52; // x + exp_shift rounds x to integer
+	// 1/k! for k = 13, ..., 0
+	inline constexpr double exp_c[] = {
+		1. / 6227020800, 1. / 479001600, 1. / 39916800, 1. / 3628800, 1. / 362880, 1. / 40320,
+		1. / 5040, 1. / 720, 1. / 120, 1. / 24, 1. / 6, 1. / 2, 1, 1
+	};
+
+	template<class T>
+	inline void exp_scalar(const T* p, T* q, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i) {
+			q[i] = std::exp(p[i]);
+		}
+	}
+
+#if FMS_SIMD_X86
+
+	// 128 bit registers
+	template<class T>
+	struct sse2;
+
+	template<>
+	struct sse2<double> {
+		using V = __m128d;
+		static constexpr size_t N = 2;
+		static V load(const double* p) { return _mm_loadu_pd(p); }
+		static V set(double x) { return _mm_set1_pd(x); }
+		static V or_(V a, V b) { return _mm_or_pd(a, b); }
+		static int mask(V a) { return _mm_movemask_pd(a); }
+		static void store(double* p, V a) { _mm_storeu_pd(p, a); }
+		static V add(V a, V b) { return _mm_add_pd(a, b); }
+		static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+		static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+		static V and_(V a, V b) { return _mm_and_pd(a, b); }
+		// a 2^k where b = k + exp_shift, low bits of b are k
+		static V add_exponent(V a, V b) { return _mm_castsi128_pd(_mm_add_epi64(_mm_castpd_si128(a), _mm_slli_epi64(_mm_castpd_si128(b), 52))); }
+		template<cmp C>
+		static V compare(V a, V x)
+		{
+			if constexpr (C == cmp::lt) return _mm_cmplt_pd(a, x);
+			else if constexpr (C == cmp::le) return _mm_cmple_pd(a, x);
+			else if constexpr (C == cmp::gt) return _mm_cmpgt_pd(a, x);
+			else if constexpr (C == cmp::ge) return _mm_cmpge_pd(a, x);
+			else if constexpr (C == cmp::eq) return _mm_cmpeq_pd(a, x);
+			else if constexpr (C == cmp::ne) return _mm_cmpneq_pd(a, x);
+			else return _mm_cmpunord_pd(a, a);
+		}
+	};
+	template<>
+	struct sse2<float> {
+		using V = __m128;
+		static constexpr size_t N = 4;
+		static V load(const float* p) { return _mm_loadu_ps(p); }
+		static V set(float x) { return _mm_set1_ps(x); }
+		static V or_(V a, V b) { return _mm_or_ps(a, b); }
+		static int mask(V a) { return _mm_movemask_ps(a); }
+		template<cmp C>
+		static V compare(V a, V x)
+		{
+			if constexpr (C == cmp::lt) return _mm_cmplt_ps(a, x);
+			else if constexpr (C == cmp::le) return _mm_cmple_ps(a, x);
+			else if constexpr (C == cmp::gt) return _mm_cmpgt_ps(a, x);
+			else if constexpr (C == cmp::ge) return _mm_cmpge_ps(a, x);
+			else if constexpr (C == cmp::eq) return _mm_cmpeq_ps(a, x);
+			else if constexpr (C == cmp::ne) return _mm_cmpneq_ps(a, x);
+			else return _mm_cmpunord_ps(a, a);
+		}
+	};
+
+	// 256 bit registers
+	template<class T>
+	struct avx2;
+
+	template<cmp C>
+	inline constexpr int avx_predicate = C == cmp::lt ? _CMP_LT_OQ
+		: C == cmp::le ? _CMP_LE_OQ
+		: C == cmp::gt ? _CMP_GT_OQ
+		: C == cmp::ge ? _CMP_GE_OQ
+		: C == cmp::eq ? _CMP_EQ_OQ
+		: C == cmp::ne ? _CMP_NEQ_UQ
+		: _CMP_UNORD_Q;
+
+	template<>
+	struct avx2<double> {
+		using V = __m256d;
+		static constexpr size_t N = 4;
+		FMS_TARGET_AVX2 static V load(const double* p) { return _mm256_loadu_pd(p); }
+		FMS_TARGET_AVX2 static V set(double x) { return _mm256_set1_pd(x); }
+		FMS_TARGET_AVX2 static V or_(V a, V b) { return _mm256_or_pd(a, b); }
+		FMS_TARGET_AVX2 static int mask(V a) { return _mm256_movemask_pd(a); }
+		FMS_TARGET_AVX2 static void store(double* p, V a) { _mm256_storeu_pd(p, a); }
+		FMS_TARGET_AVX2 static V add(V a, V b) { return _mm256_add_pd(a, b); }
+		FMS_TARGET_AVX2 static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+		FMS_TARGET_AVX2 static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+		FMS_TARGET_AVX2 static V and_(V a, V b) { return _mm256_and_pd(a, b); }
+		FMS_TARGET_AVX2 static V add_exponent(V a, V b) { return _mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(a), _mm256_slli_epi64(_mm256_castpd_si256(b), 52))); }
+		template<cmp C>
+		FMS_TARGET_AVX2 static V compare(V a, V x)
+		{
+			return C == cmp::nan ? _mm256_cmp_pd(a, a, _CMP_UNORD_Q) : _mm256_cmp_pd(a, x, avx_predicate<C>);
+		}
+	};
+	template<>
+	struct avx2<float> {
+		using V = __m256;
+		static constexpr size_t N = 8;
+		FMS_TARGET_AVX2 static V load(const float* p) { return _mm256_loadu_ps(p); }
+		FMS_TARGET_AVX2 static V set(float x) { return _mm256_set1_ps(x); }
+		FMS_TARGET_AVX2 static V or_(V a, V b) { return _mm256_or_ps(a, b); }
+		FMS_TARGET_AVX2 static int mask(V a) { return _mm256_movemask_ps(a); }
+		template<cmp C>
+		FMS_TARGET_AVX2 static V compare(V a, V x)
+		{
+			return C == cmp::nan ? _mm256_cmp_ps(a, a, _CMP_UNORD_Q) : _mm256_cmp_ps(a, x, avx_predicate<C>);
+		}
+	};
+
+	// Two registers per iteration, then the scalar tail.
+	// The bodies are identical but gcc needs the target on the caller.
+#define FMS_SIMD_FIND_BODY \
+		using R = S<T>; \
+		constexpr size_t N = R::N; \
+		auto x_ = R::set(x); \
+		size_t i = 0; \
+		for (; i + 2 * N <= n; i += 2 * N) { \
+			auto a = R::template compare<C>(R::load(p + i), x_); \
+			auto b = R::template compare<C>(R::load(p + i + N), x_); \
+			if (R::mask(R::or_(a, b))) { \
+				int m = R::mask(a); \
+				return m ? i + std::countr_zero(unsigned(m)) : i + N + std::countr_zero(unsigned(R::mask(b))); \
+			} \
+		} \
+		return i + find_scalar<C>(p + i, n - i, x);
+
+#define FMS_SIMD_MISMATCH_BODY \
+		using R = S<T>; \
+		constexpr size_t N = R::N; \
+		size_t i = 0; \
+		for (; i + N <= n; i += N) { \
+			if (int m = R::mask(R::template compare<cmp::ne>(R::load(p + i), R::load(q + i)))) { \
+				return i + std::countr_zero(unsigned(m)); \
+			} \
+		} \
+		return i + mismatch_scalar(p + i, q + i, n - i);
+
+	template<template<class> class S, cmp C, class T>
+	inline size_t find_sse2(const T* p, size_t n, const T& x)
+	{
+		FMS_SIMD_FIND_BODY
+	}
+	template<template<class> class S, cmp C, class T>
+	FMS_TARGET_AVX2 inline size_t find_avx2(const T* p, size_t n, const T& x)
+	{
+		FMS_SIMD_FIND_BODY
+	}
+	template<template<class> class S, class T>
+	inline size_t mismatch_sse2(const T* p, const T* q, size_t n)
+	{
+		FMS_SIMD_MISMATCH_BODY
+	}
+	template<template<class> class S, class T>
+	FMS_TARGET_AVX2 inline size_t mismatch_avx2(const T* p, const T* q, size_t n)
+	{
+		FMS_SIMD_MISMATCH_BODY
+	}
+
+	// out of range and NaN lanes use std::exp
+#define FMS_SIMD_EXP_BODY \
+		using R = S<double>; \
+		constexpr size_t N = R::N; \
+		const auto lo = R::set(exp_lo), hi = R::set(exp_hi); \
+		const auto log2e = R::set(exp_log2e), shift = R::set(exp_shift); \
+		const auto ln2_hi = R::set(exp_ln2_hi), ln2_lo = R::set(exp_ln2_lo); \
+		size_t i = 0; \
+		for (; i + N <= n; i += N) { \
+			auto x = R::load(p + i); \
+			int in = R::mask(R::and_(R::template compare<cmp::ge>(x, lo), R::template compare<cmp::le>(x, hi))); \
+			auto k = R::add(R::mul(x, log2e), shift); \
+			auto kd = R::sub(k, shift); \
+			auto r = R::sub(R::sub(x, R::mul(kd, ln2_hi)), R::mul(kd, ln2_lo)); \
+			auto e = R::set(exp_c[0]); \
+			e = R::add(R::mul(e, r), R::set(exp_c[1])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[2])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[3])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[4])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[5])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[6])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[7])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[8])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[9])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[10])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[11])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[12])); \
+			e = R::add(R::mul(e, r), R::set(exp_c[13])); \
+			if (in != (1 << N) - 1) { \
+				double x_[N]; \
+				R::store(x_, x); \
+				R::store(q + i, R::add_exponent(e, k)); \
+				for (size_t j = 0; j < N; ++j) { \
+					if (!(in & (1 << j))) { \
+						q[i + j] = std::exp(x_[j]); \
+					} \
+				} \
+			} \
+			else { \
+				R::store(q + i, R::add_exponent(e, k)); \
+			} \
+		} \
+		exp_scalar(p + i, q + i, n - i);
+
+	template<template<class> class S>
+	inline void exp_sse2(const double* p, double* q, size_t n)
+	{
+		FMS_SIMD_EXP_BODY
+	}
+	template<template<class> class S>
+	FMS_TARGET_AVX2 inline void exp_avx2(const double* p, double* q, size_t n)
+	{
+		FMS_SIMD_EXP_BODY
+	}
+
+#undef FMS_SIMD_FIND_BODY
+#undef FMS_SIMD_MISMATCH_BODY
+#undef FMS_SIMD_EXP_BODY
+
+#endif // FMS_SIMD_X86
+
+	// vectorized types
+	template<class T>
+	inline constexpr bool vectorized = FMS_SIMD_X86 and (std::is_same_v<T, double> or std::is_same_v<T, float>);
+
+	// index of first p[i] C x, or n
+	template<cmp C, class T>
+	inline size_t find(const T* p, size_t n, const T& x, level l = best())
+	{
+#if FMS_SIMD_X86
+		if constexpr (vectorized<T>) {
+			if (l == level::avx2) {
+				return find_avx2<avx2, C>(p, n, x);
+			}
+			if (l == level::sse2) {
+				return find_sse2<sse2, C>(p, n, x);
+			}
+		}
+#endif
+		return find_scalar<C>(p, n, x);
+	}
+
+	// index of first p[i] != q[i], or n
+	template<class T>
+	inline size_t mismatch(const T* p, const T* q, size_t n, level l = best())
+	{
+#if FMS_SIMD_X86
+		if constexpr (vectorized<T>) {
+			if (l == level::avx2) {
+				return mismatch_avx2<avx2>(p, q, n);
+			}
+			if (l == level::sse2) {
+				return mismatch_sse2<sse2>(p, q, n);
+			}
+		}
+#endif
+		return mismatch_scalar(p, q, n);
+	}
+
+	// q[i] = exp(p[i]), p == q allowed
+	template<class T>
+	inline void exp(const T* p, T* q, size_t n, level l = best())
+	{
+#if FMS_SIMD_X86
+		if constexpr (std::is_same_v<T, double>) {
+			if (l == level::avx2) {
+				return exp_avx2<avx2>(p, q, n);
+			}
+			if (l == level::sse2) {
+				return exp_sse2<sse2>(p, q, n);
+			}
+		}
+#endif
+		exp_scalar(p, q, n);
+	}
+
+#ifdef _DEBUG
+	template<class T>
+	inline int test()
+	{
+		std::vector<level> ls = { level::scalar };
+#if FMS_SIMD_X86
+		ls.push_back(level::sse2);
+		if (best() == level::avx2) {
+			ls.push_back(level::avx2);
+		}
+#endif
+		std::vector<T> v(37);
+		for (size_t i = 0; i < v.size(); ++i) {
+			v[i] = static_cast<T>(i);
+		}
+		for (level l : ls) {
+			for (size_t n = 0; n <= v.size(); ++n) {
+				for (size_t k = 0; k < n; ++k) {
+					T x = v[k];
+					assert(k == find<cmp::ge>(v.data(), n, x, l));
+					assert(k == find<cmp::eq>(v.data(), n, x, l));
+					assert((k + 1 < n ? k + 1 : n) == find<cmp::gt>(v.data(), n, x, l));
+					assert(0 == find<cmp::le>(v.data(), n, x, l));
+					assert((k ? 0 : n) == find<cmp::lt>(v.data(), n, x, l));
+					assert((k ? 0 : (n > 1 ? 1 : n)) == find<cmp::ne>(v.data(), n, x, l));
+				}
+				assert(n == find<cmp::nan>(v.data(), n, T(0), l));
+				assert(n == mismatch(v.data(), v.data(), n, l));
+			}
+			if constexpr (std::numeric_limits<T>::has_quiet_NaN) {
+				auto w = v;
+				w[29] = std::numeric_limits<T>::quiet_NaN();
+				assert(29 == find<cmp::nan>(w.data(), w.size(), T(0), l));
+				assert(29 == find<cmp::ne>(w.data() + 29, 1, T(0), l) + 29);
+				assert(29 == mismatch(v.data(), w.data(), v.size(), l));
+				// NaN != NaN
+				assert(29 == mismatch(w.data(), w.data(), w.size(), l));
+			}
+			if constexpr (std::is_floating_point_v<T>) {
+				std::vector<T> x, y;
+				for (T t = -750; t < 750; t += T(0.37)) {
+					x.push_back(t);
+				}
+				x.push_back(0);
+				x.push_back(std::numeric_limits<T>::infinity());
+				x.push_back(-std::numeric_limits<T>::infinity());
+				x.push_back(std::numeric_limits<T>::quiet_NaN());
+				y.resize(x.size());
+				exp(x.data(), y.data(), x.size(), l);
+				for (size_t i = 0; i < x.size(); ++i) {
+					T e = std::exp(x[i]);
+					assert(y[i] == e or std::fabs(y[i] - e) <= 4 * std::numeric_limits<T>::epsilon() * e or (std::isnan(e) and std::isnan(y[i])));
+				}
+				exp(x.data(), x.data(), x.size(), l); // in place
+				assert(std::equal(x.begin(), x.end() - 1, y.begin()));
+			}
+		}
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
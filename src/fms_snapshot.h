@@ -0,0 +1,325 @@
+// fms_snapshot.h - binary file of indexed curves read by memory mapping
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#include <cstddef>
+#endif
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include "fms_mmap.h"
+#include "fms_pwflat.h"
+
+namespace fms::pwflat {
+
+	// File layout, all offsets in bytes from the start of the file:
+	// header, then for each curve times, rates and integrals each starting
+	// on a snapshot_align boundary, then the directory of curves.
+	// Numbers are stored in the writer's byte order recorded in endian.
+	inline constexpr char snapshot_magic[8] = { 'F', 'M', 'S', 'P', 'W', 'F', 'L', 0 };
+	inline constexpr uint32_t snapshot_version = 1;
+	inline constexpr uint32_t snapshot_endian = 0x01020304;
+	inline constexpr size_t snapshot_align = 64;
+
+	struct snapshot_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t endian;
+		uint32_t time_size; // sizeof(T)
+		uint32_t rate_size; // sizeof(X)
+		uint64_t count;     // number of curves
+		uint64_t directory; // offset of directory
+		uint64_t reserved[3];
+	};
+	static_assert(sizeof(snapshot_header) == snapshot_align);
+
+	template<class X>
+	struct snapshot_entry {
+		uint64_t n;      // pillars
+		uint64_t offset; // of times, rates follow at the next aligned offset, then integrals
+		X _x;            // extrapolation
+	};
+
+	// offset of the array following n items of size s at offset o
+	inline constexpr uint64_t snapshot_next(uint64_t o, uint64_t n, uint64_t s)
+	{
+		o += n * s;
+
+		return (o + snapshot_align - 1) / snapshot_align * snapshot_align;
+	}
+
+	// Append curves then close to write the directory.
+	template<class T = double, class X = double>
+	class snapshot_writer {
+		std::ofstream os;
+		std::vector<snapshot_entry<X>> dir;
+		uint64_t o; // current offset
+
+		void pad()
+		{
+			static const char zero[snapshot_align] = {};
+			uint64_t o_ = snapshot_next(o, 0, 0);
+			os.write(zero, o_ - o);
+			o = o_;
+		}
+		template<class U>
+		void write(const U* p, size_t n)
+		{
+			os.write(reinterpret_cast<const char*>(p), n * sizeof(U));
+			o += n * sizeof(U);
+			pad();
+		}
+	public:
+		snapshot_writer(const char* path)
+			: os(path, std::ios::binary | std::ios::trunc), o(0)
+		{
+			if (!os) {
+				throw std::runtime_error(std::string("fms::pwflat::snapshot_writer: cannot open ") + path);
+			}
+			snapshot_header h{};
+			write(&h, 1); // patched by close
+		}
+		snapshot_writer(const snapshot_writer&) = delete;
+		snapshot_writer& operator=(const snapshot_writer&) = delete;
+		~snapshot_writer()
+		{
+			if (os.is_open()) {
+				try {
+					close();
+				}
+				catch (...) {
+				}
+			}
+		}
+
+		// index of curve in the snapshot
+		size_t add(const indexed_view<T, X>& f)
+		{
+			size_t n = f.size();
+
+			auto& e = dir.emplace_back();
+			std::memset(&e, 0, sizeof(e)); // padding is written to the file
+			e.n = n;
+			e.offset = o;
+			e._x = f.extrapolate();
+			write(f.time().data(), n);
+			write(f.rate().data(), n);
+			write(f.integrals().data(), n);
+
+			return dir.size() - 1;
+		}
+
+		void close()
+		{
+			snapshot_header h{};
+			std::memcpy(h.magic, snapshot_magic, sizeof(h.magic));
+			h.version = snapshot_version;
+			h.endian = snapshot_endian;
+			h.time_size = sizeof(T);
+			h.rate_size = sizeof(X);
+			h.count = dir.size();
+			h.directory = o;
+
+			write(dir.data(), dir.size());
+			os.seekp(0);
+			os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+			os.close();
+			if (!os) {
+				throw std::runtime_error("fms::pwflat::snapshot_writer: write failed");
+			}
+		}
+	};
+
+	// Curves of a snapshot file as views into the mapping. Nothing is
+	// parsed or copied. Views are valid for the lifetime of the snapshot.
+	// The constructor checks every curve lies in the file.
+	template<class T = double, class X = double>
+	class snapshot {
+		mapped<std::byte> m;
+		const snapshot_entry<X>* dir;
+		size_t count;
+
+		static void fail(const char* what)
+		{
+			throw std::runtime_error(std::string("fms::pwflat::snapshot: ") + what);
+		}
+		template<class U>
+		const U* at(uint64_t o) const
+		{
+			return reinterpret_cast<const U*>(m.data() + o);
+		}
+		// arrays of e lie in the file
+		bool in_file(const snapshot_entry<X>& e) const
+		{
+			if (e.offset > m.size() or e.n > m.size()) {
+				return false;
+			}
+
+			return snapshot_next(snapshot_next(snapshot_next(e.offset, e.n, sizeof(T)), e.n, sizeof(X)), e.n, sizeof(X)) <= m.size();
+		}
+	public:
+		snapshot(const char* path, advice a = advice::normal)
+			: m(path, a), dir(nullptr), count(0)
+		{
+			if (m.size() < sizeof(snapshot_header)) {
+				fail("file too small");
+			}
+			const auto& h = *at<snapshot_header>(0);
+			if (std::memcmp(h.magic, snapshot_magic, sizeof(h.magic))) {
+				fail("not a snapshot");
+			}
+			if (h.endian != snapshot_endian) {
+				fail("byte order differs");
+			}
+			if (h.version != snapshot_version) {
+				fail("unknown version");
+			}
+			if (h.time_size != sizeof(T) or h.rate_size != sizeof(X)) {
+				fail("type sizes differ");
+			}
+			if (h.directory > m.size() or (m.size() - h.directory) / sizeof(snapshot_entry<X>) < h.count) {
+				fail("directory out of range");
+			}
+			dir = at<snapshot_entry<X>>(h.directory);
+			for (size_t i = 0; i < h.count; ++i) {
+				if (!in_file(dir[i])) {
+					fail("curve out of range");
+				}
+			}
+			count = h.count;
+		}
+		snapshot(const snapshot&) = delete;
+		snapshot& operator=(const snapshot&) = delete;
+		~snapshot()
+		{ }
+
+		// number of curves
+		size_t size() const
+		{
+			return count;
+		}
+
+		// curve i
+		indexed_view<T, X> operator[](size_t i) const
+		{
+			if (i >= count) {
+				throw std::out_of_range("fms::pwflat::snapshot::operator[]: curve index out of range");
+			}
+			const auto& e = dir[i];
+			uint64_t ox = snapshot_next(e.offset, e.n, sizeof(T));
+			uint64_t oI = snapshot_next(ox, e.n, sizeof(X));
+
+			return indexed_view<T, X>(e.n, at<T>(e.offset), at<X>(ox), at<X>(oI), e._x);
+		}
+		// check offsets of curve i lie in the file
+		bool valid(size_t i) const
+		{
+			return i < count and in_file(dir[i]);
+		}
+
+		void advise(advice a) const
+		{
+			m.advise(a);
+		}
+	};
+
+#ifdef _DEBUG
+	inline int test_snapshot()
+	{
+		auto path = test_path("fms_snapshot_test").string();
+		double t[] = { 1, 2, 3 };
+		double x[] = { .01, .02, .03 };
+		indexed f(array(t), array(x), .04);
+		indexed g(take(2, ptr(t)), take(2, ptr(x)));
+		indexed<> h(.05);
+		{
+			snapshot_writer w(path.c_str());
+			assert(0 == w.add(f));
+			assert(1 == w.add(g));
+			assert(2 == w.add(h));
+		}
+		{
+			snapshot s(path.c_str());
+			assert(3 == s.size());
+			for (size_t i = 0; i < s.size(); ++i) {
+				assert(s.valid(i));
+			}
+			auto f_ = s[0];
+			assert(reinterpret_cast<uintptr_t>(f_.time().data()) % snapshot_align == 0);
+			assert(reinterpret_cast<uintptr_t>(f_.rate().data()) % snapshot_align == 0);
+			assert(equal(f_.time(), f.time()));
+			assert(equal(f_.integrals(), f.integrals()));
+			assert(.04 == f_.extrapolate());
+			for (double _t = 0; _t < 5; _t += .25) {
+				assert(f_.discount(_t) == f.discount(_t));
+				assert(s[1].value(_t) == g.value(_t) or (std::isnan(s[1].value(_t)) and std::isnan(g.value(_t))));
+				assert(s[2].integral(_t) == h.integral(_t));
+			}
+			assert(!s.valid(3));
+			try {
+				s[3];
+				assert(false);
+			}
+			catch (const std::out_of_range&) {
+			}
+		}
+		{
+			// padding of float entries is zero
+			snapshot_writer<double, float> w(path.c_str());
+			w.add(indexed<double, float>(.05f));
+		}
+		{
+			std::ifstream is(path, std::ios::binary);
+			snapshot_header h;
+			is.read(reinterpret_cast<char*>(&h), sizeof(h));
+			is.seekg(h.directory);
+			char e[sizeof(snapshot_entry<float>)];
+			is.read(e, sizeof(e));
+			for (size_t i = offsetof(snapshot_entry<float>, _x) + sizeof(float); i < sizeof(e); ++i) {
+				assert(0 == e[i]);
+			}
+		}
+		{
+			// corrupt offset of curve 1
+			snapshot_writer w(path.c_str());
+			w.add(f);
+			w.add(g);
+		}
+		{
+			std::fstream fs(path, std::ios::binary | std::ios::in | std::ios::out);
+			snapshot_header h;
+			fs.read(reinterpret_cast<char*>(&h), sizeof(h));
+			uint64_t o = uint64_t(-1) / 2;
+			fs.seekp(h.directory + sizeof(snapshot_entry<double>) + offsetof(snapshot_entry<double>, offset));
+			fs.write(reinterpret_cast<const char*>(&o), sizeof(o));
+		}
+		try {
+			snapshot s(path.c_str());
+			assert(false);
+		}
+		catch (const std::runtime_error&) {
+		}
+		{
+			snapshot_writer w(path.c_str());
+			w.add(f);
+		}
+		{
+			// corrupt magic
+			std::fstream fs(path, std::ios::binary | std::ios::in | std::ios::out);
+			fs.put('X');
+		}
+		try {
+			snapshot s(path.c_str());
+			assert(false);
+		}
+		catch (const std::runtime_error&) {
+		}
+		std::filesystem::remove(path);
+
+		return 0;
+	}
+#endif // _DEBUG
+
+} // namespace fms
@@ -1,8 +1,24 @@
 // test.cpp
 #include <cassert>
+#include "fms_arena.h"
+#include "fms_bootstrap.h"
+#include "fms_buffer.h"
+#include "fms_cache.h"
+#include "fms_generator.h"
 #include "fms_iterable.h"
+#include "fms_live.h"
+#include "fms_lu.h"
+#include "fms_merge.h"
+#include "fms_mmap.h"
+#include "fms_overlay.h"
+#include "fms_parallel.h"
+#include "fms_portfolio.h"
+#include "fms_ranges.h"
 #include "fms_pwflat.h"
+#include "fms_reduce.h"
 #include "fms_root1d.h"
+#include "fms_schedule.h"
+#include "fms_snapshot.h"
 //#include "distribution.h"
 
 using namespace fms;
@@ -39,17 +55,54 @@ int test_take = take<ptr<int>>::test();
 int test_counted = counted<ptr<int>>::test();
 
 int test_array_i = test_array<int>();
+int test_pair_i = test_pair<int>();
 
 int test_length0 = test_length(take(2, sequence<int>()), take(3, sequence<int>()));
 int test_length1 = test_length(take(0, sequence<int>()), take(3, sequence<int>()));
 int test_length2 = test_length(take(0, sequence<int>()), take(0, sequence<int>()));
 
 int test_apply_ = test_apply();
+int test_upto_ = test_upto();
+
+int test_simd_d = simd::test<double>();
+int test_simd_f = simd::test<float>();
+int test_simd_i = simd::test<int>();
+
+int test_pipe = pipe::test();
+
+int test_fold_ = test_fold();
+int test_reduce_ = test_reduce();
+int test_parallel = parallel::test();
+int test_ranges_ = test_ranges();
+int test_buffer_ = test_buffer();
+int test_merge_ = test_merge();
+
+int test_arena = arena::test();
+int test_generator_ = test_generator();
+
+int test_mapped = mapped<double>::test();
 
 int test_root1d = root1d::secant<double,double>::test();
+int test_newton_bracket = root1d::test_newton_bracket();
+int test_banded = lu::test_banded();
 
 int test_value = pwflat::test_value();
+int test_integral = pwflat::test_integral();
 int test_pwflat = pwflat::test();
+int test_indexed = pwflat::test_indexed();
+int test_adjoint = pwflat::test_adjoint();
+int test_static_curve = pwflat::test_static_curve();
+int test_live = pwflat::test_live();
+int test_cache = pwflat::test_cache();
+int test_snapshot = pwflat::test_snapshot();
+int test_overlay = pwflat::test_overlay();
+int test_fra = bootstrap::test_fra();
+int test_sequential = bootstrap::test_sequential();
+int test_batch = bootstrap::test_batch();
+int test_global = bootstrap::test_global();
+int test_rebootstrap = bootstrap::test_rebootstrap();
+int test_schedule = schedule::test_schedule();
+int test_portfolio = pwflat::test_portfolio();
 
 int test_container = container<std::vector<int>>::test();
 